@@ -17,20 +17,44 @@ void App::window_size_callback(GLFWwindow* window,
   app_instance->window_height = new_height;
 }
 
+void App::key_callback(GLFWwindow* window,
+                       int key,
+                       int scancode,
+                       int action,
+                       int mods) {
+  auto app_instance = static_cast<App*>(glfwGetWindowUserPointer(window));
+  if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+    app_instance->memory_stats_requested = true;
+  }
+  if (key == GLFW_KEY_F10 && action == GLFW_PRESS) {
+    app_instance->gpu_times_requested = true;
+  }
+}
+
 void App::initialize_event_listeners(Context& cx) {
   glfwSetWindowUserPointer(window, this);
   glfwSetWindowSizeCallback(window, window_size_callback);
   glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  glfwSetKeyCallback(window, key_callback);
 }
 
 void App::init_window(Context& cx) {
+  TRACE_SCOPE("init_window");
+  if (options.headless) {
+    // the offscreen images are exactly this size, no scaling to account for
+    framebuffer_width = window_width = static_cast<int>(options.width);
+    framebuffer_height = window_height = static_cast<int>(options.height);
+    return;
+  }
   if (!glfwInit()) {
     throw runtime_error("failed to initialize glfw!");
   };
 
   // disable opengl context
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Window", nullptr, nullptr);
+  window = glfwCreateWindow(static_cast<int>(options.width),
+                            static_cast<int>(options.height), "Vulkan Window",
+                            nullptr, nullptr);
 
   glfwGetWindowSize(window, &window_width, &window_height);
   glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
@@ -116,27 +140,30 @@ void App::dbg_get_available_instance_extensions() {
 }
 
 vector<const char*> App::get_required_instance_extensions() {
-  // debug
-  assert(glfwVulkanSupported());
-
-  // query glfw for the extensions it needs
-  u32 extensions_count;
-  // guarantees the inclusion of VK_KHR_surface
-  // if on MacOS, includes VK_EXT_metal_surface
-  const char** t_extensions =
-      glfwGetRequiredInstanceExtensions(&extensions_count);
-
-  // debug
-  // cout << "there are " << extensions_count << " required glfw
-  // extensions."
-  //      << endl;
-
   vector<const char*> extensions;
-  for (unsigned int i = 0; i < extensions_count; i++) {
-    extensions.emplace_back(t_extensions[i]);
+  // headless, glfw isn't initialized and no surface extension is needed
+  if (!options.headless) {
+    // debug
+    assert(glfwVulkanSupported());
+
+    // query glfw for the extensions it needs
+    u32 extensions_count;
+    // guarantees the inclusion of VK_KHR_surface
+    // if on MacOS, includes VK_EXT_metal_surface
+    const char** t_extensions =
+        glfwGetRequiredInstanceExtensions(&extensions_count);
+
+    // debug
+    // cout << "there are " << extensions_count << " required glfw
+    // extensions."
+    //      << endl;
+
+    for (unsigned int i = 0; i < extensions_count; i++) {
+      extensions.emplace_back(t_extensions[i]);
+    }
+    // add the khr 2 extension
+    extensions.emplace_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
   }
-  // add the khr 2 extension
-  extensions.emplace_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
   if (strcmp(os, "macos") == 0) {
     extensions.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
   }
@@ -154,6 +181,7 @@ vector<const char*> App::get_required_instance_extensions() {
 }
 
 void App::create_instance(Context& cx) {
+  TRACE_SCOPE("create_instance");
   VkApplicationInfo app_info{.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
                              .pApplicationName = "Vulkan",
                              .applicationVersion = VK_MAKE_VERSION(0, 1, 0),
@@ -163,6 +191,13 @@ void App::create_instance(Context& cx) {
 
   // get required extensions
   auto extensions = get_required_instance_extensions();
+  // needed for VK_EXT_swapchain_maintenance1 on the device
+  cx.surface_maintenance1 =
+      !options.headless &&
+      instance_supports_extension(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+  if (cx.surface_maintenance1) {
+    extensions.emplace_back(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+  }
 
   VkInstanceCreateInfo create_info{
       .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -191,11 +226,14 @@ void App::create_instance(Context& cx) {
     create_info.pNext = &debug_messenger_info;
   }
 
-  if (vkCreateInstance(&create_info, nullptr, &cx.instance) != VK_SUCCESS) {
+  if (vkCreateInstance(&create_info, vk_allocator(VK_OBJECT_TYPE_INSTANCE),
+                       &cx.instance) != VK_SUCCESS) {
     throw runtime_error("failed to create instance");
   };
-  cx.deletion_stack.push(
-      [this]() { vkDestroyInstance(this->cx.instance, nullptr); });
+  cx.deletion_queue.push([this]() {
+    vkDestroyInstance(this->cx.instance,
+                      vk_allocator(VK_OBJECT_TYPE_INSTANCE));
+  });
 }
 
 VkResult App::CreateDebugUtilsMessengerEXT(
@@ -240,6 +278,7 @@ VkDebugUtilsMessengerCreateInfoEXT App::get_debug_messenger_info() {
 }
 
 void App::setup_debug_messenger() {
+  TRACE_SCOPE("setup_debug_messenger");
   if (!enableValidationLayers) {
     return;
   }
@@ -248,14 +287,17 @@ void App::setup_debug_messenger() {
   // could be a usecase for `volk`
   VkDebugUtilsMessengerCreateInfoEXT debug_messenger_info =
       get_debug_messenger_info();
-  if (CreateDebugUtilsMessengerEXT(cx.instance, &debug_messenger_info, nullptr,
-                                   &cx.debug_messenger) != VK_SUCCESS) {
+  if (CreateDebugUtilsMessengerEXT(
+          cx.instance, &debug_messenger_info,
+          vk_allocator(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT),
+          &cx.debug_messenger) != VK_SUCCESS) {
     throw runtime_error("failed to create debug messenger");
   };
-  cx.deletion_stack.push([this]() { this->destroy_debug_messenger(this->cx); });
+  cx.deletion_queue.push([this]() { this->destroy_debug_messenger(this->cx); });
 }
 
 void App::choose_physical_device(Context& cx) {
+  TRACE_SCOPE("choose_physical_device");
   u32 physical_device_count;
   vkEnumeratePhysicalDevices(cx.instance, &physical_device_count, nullptr);
   vector<VkPhysicalDevice> physical_devices(physical_device_count);
@@ -333,9 +375,12 @@ App::QueueFamilyIndex App::find_queue_family_index(Context& cx) {
   int i = 0;
   for (auto& p : queue_family_properties) {
     if ((p.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
-      VkBool32 present_support = false;
-      vkGetPhysicalDeviceSurfaceSupportKHR(cx.physical_device, i, cx.surface,
-                                           &present_support);
+      // nothing is presented headless, any graphics queue does
+      VkBool32 present_support = options.headless;
+      if (!options.headless) {
+        vkGetPhysicalDeviceSurfaceSupportKHR(cx.physical_device, i,
+                                             cx.surface, &present_support);
+      }
       if (present_support) {
         draw_and_present_family = i;
         break;
@@ -371,6 +416,34 @@ bool App::device_includes_extensions() {
   return includes;
 }
 
+bool App::device_supports_extension(Context& cx, const char* name) {
+  u32 count = 0;
+  vkEnumerateDeviceExtensionProperties(cx.physical_device, nullptr, &count,
+                                       nullptr);
+  vector<VkExtensionProperties> properties(count);
+  vkEnumerateDeviceExtensionProperties(cx.physical_device, nullptr, &count,
+                                       properties.data());
+  for (auto& p : properties) {
+    if (strcmp(p.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool App::instance_supports_extension(const char* name) {
+  u32 count = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
+  vector<VkExtensionProperties> properties(count);
+  vkEnumerateInstanceExtensionProperties(nullptr, &count, properties.data());
+  for (auto& p : properties) {
+    if (strcmp(p.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool App::is_device_suitable(Context& cx) {
   // check if device contains VK_KHR_buffer_device_address support
   bool buffer_device_address_support = false;
@@ -390,6 +463,21 @@ bool App::is_device_suitable(Context& cx) {
     }
   }
 
+  // every vertex shader indexes its draw data with gl_DrawID
+  {
+    VkPhysicalDeviceVulkan11Features features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
+    VkPhysicalDeviceFeatures2 device_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features};
+    vkGetPhysicalDeviceFeatures2(cx.physical_device, &device_features);
+
+    if (features.shaderDrawParameters != VK_TRUE) {
+      println("device doesn't support shaderDrawParameters (gl_DrawID)");
+      return false;
+    }
+  }
+
   QueueFamilyIndex queue_family_index = find_queue_family_index(cx);
 
   bool swapchain_support = false;
@@ -399,6 +487,7 @@ bool App::is_device_suitable(Context& cx) {
 }
 
 void App::create_logical_device(Context& cx) {
+  TRACE_SCOPE("create_logical_device");
   if (!is_device_suitable(cx)) {
     throw runtime_error("device not suitable for various reasons");
   }
@@ -428,8 +517,76 @@ void App::create_logical_device(Context& cx) {
 
   // also put wanted device extensions here
   for (auto e : wanted_device_extensions) {
+    if (options.headless && strcmp(e, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) {
+      continue;
+    }
     extensions.emplace_back(e);
   }
+  // real per-heap budgets from the driver instead of vma's estimates
+  cx.memory_budget_extension =
+      device_supports_extension(cx, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (cx.memory_budget_extension) {
+    extensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  }
+  // presents that signal a fence, for retiring old swapchains
+  VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT
+      swapchain_maintenance1_features = {
+          .sType =
+              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT};
+  if (cx.surface_maintenance1 &&
+      device_supports_extension(
+          cx, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME)) {
+    VkPhysicalDeviceFeatures2 supported_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &swapchain_maintenance1_features};
+    vkGetPhysicalDeviceFeatures2(cx.physical_device, &supported_features);
+    cx.swapchain_maintenance1 =
+        swapchain_maintenance1_features.swapchainMaintenance1 == VK_TRUE;
+  }
+  if (cx.swapchain_maintenance1) {
+    extensions.emplace_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+  }
+  // pacing on actual presentation needs both extensions and their features
+  VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+  VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+      .pNext = &present_wait_features};
+  if (options.present_wait && !options.headless &&
+      device_supports_extension(cx, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+      device_supports_extension(cx, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+    VkPhysicalDeviceFeatures2 supported_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &present_id_features};
+    vkGetPhysicalDeviceFeatures2(cx.physical_device, &supported_features);
+    cx.present_wait = present_id_features.presentId == VK_TRUE &&
+                      present_wait_features.presentWait == VK_TRUE;
+  }
+  if (cx.present_wait) {
+    extensions.emplace_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    extensions.emplace_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  } else if (options.present_wait && !options.headless) {
+    println("VK_KHR_present_wait isn't supported, not pacing on presents");
+  }
+  // a batch's draw count comes from a buffer, and it's usually more than 1.
+  // instanced draws after the first start at a nonzero firstInstance
+  if (options.indirect_draws) {
+    VkPhysicalDeviceVulkan12Features supported_12_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 supported_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported_12_features};
+    vkGetPhysicalDeviceFeatures2(cx.physical_device, &supported_features);
+    cx.indirect_draws =
+        supported_features.features.multiDrawIndirect == VK_TRUE &&
+        supported_features.features.drawIndirectFirstInstance == VK_TRUE &&
+        supported_12_features.drawIndirectCount == VK_TRUE;
+    if (!cx.indirect_draws) {
+      println(
+          "vkCmdDrawIndirectCount with a first instance isn't supported, "
+          "drawing directly");
+    }
+  }
 
   vector<const char*> validation_layers = {"VK_LAYER_KHRONOS_validation"};
   if (enableValidationLayers && !layers_exists(&validation_layers)) {
@@ -438,19 +595,44 @@ void App::create_logical_device(Context& cx) {
         "does not exist on device");
   }
 
-  VkPhysicalDeviceBufferDeviceAddressFeatures
-      physical_device_buffer_device_address_features = {
-          .sType =
-              VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
-          .bufferDeviceAddress = VK_TRUE};
+  // gl_DrawID in the vertex shader, checked by is_device_suitable
+  VkPhysicalDeviceVulkan11Features physical_device_vulkan_11_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES,
+      // both are still VK_TRUE from the query above
+      .pNext = cx.present_wait ? &present_id_features : nullptr,
+      .shaderDrawParameters = VK_TRUE};
+
+  // timeline semaphores are core (and mandatory) since 1.2
+  VkPhysicalDeviceVulkan12Features physical_device_vulkan_12_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext = &physical_device_vulkan_11_features,
+      .drawIndirectCount = cx.indirect_draws ? VK_TRUE : VK_FALSE,
+      .timelineSemaphore = VK_TRUE,
+      .bufferDeviceAddress = VK_TRUE};
+
+  // core in 1.3, used by the dynamic rendering path
+  VkPhysicalDeviceVulkan13Features physical_device_vulkan_13_features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .pNext = &physical_device_vulkan_12_features,
+      .synchronization2 = VK_TRUE,
+      .dynamicRendering = VK_TRUE};
 
   VkPhysicalDeviceFeatures2 physical_device_features = {
       .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-      .pNext = &physical_device_buffer_device_address_features};
+      .pNext = &physical_device_vulkan_13_features,
+      .features = {.multiDrawIndirect =
+                       cx.indirect_draws ? VK_TRUE : VK_FALSE,
+                   .drawIndirectFirstInstance =
+                       cx.indirect_draws ? VK_TRUE : VK_FALSE}};
+
+  // still VK_TRUE from the query above
+  swapchain_maintenance1_features.pNext = &physical_device_features;
 
   VkDeviceCreateInfo device_create_info = {
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .pNext = &physical_device_features,
+      .pNext = cx.swapchain_maintenance1
+                   ? static_cast<const void*>(&swapchain_maintenance1_features)
+                   : &physical_device_features,
       .queueCreateInfoCount = 1,
       .pQueueCreateInfos = device_queue_create_infos.data(),
       .enabledLayerCount = static_cast<u32>(validation_layers.size()),
@@ -459,12 +641,19 @@ void App::create_logical_device(Context& cx) {
       .ppEnabledExtensionNames = extensions.data(),
   };
 
-  if (vkCreateDevice(cx.physical_device, &device_create_info, nullptr,
+  if (vkCreateDevice(cx.physical_device, &device_create_info,
+                     vk_allocator(VK_OBJECT_TYPE_DEVICE),
                      &cx.device) != VK_SUCCESS) {
     throw runtime_error("unable to create device");
   };
-  cx.deletion_stack.push(
-      [this]() { vkDestroyDevice(this->cx.device, nullptr); });
+  cx.deletion_queue.push([this]() {
+    vkDestroyDevice(this->cx.device, vk_allocator(VK_OBJECT_TYPE_DEVICE));
+  });
+  // extension entry points don't come from the loader
+  if (cx.present_wait) {
+    cx.wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+        vkGetDeviceProcAddr(cx.device, "vkWaitForPresentKHR"));
+  }
 
   // queues can be requested later based on the logical device
   VkQueue queue;
@@ -473,12 +662,15 @@ void App::create_logical_device(Context& cx) {
 }
 
 void App::create_surface(Context& cx) {
-  if (glfwCreateWindowSurface(cx.instance, window, nullptr, &cx.surface) !=
-      VK_SUCCESS) {
+  TRACE_SCOPE("create_surface");
+  if (glfwCreateWindowSurface(cx.instance, window,
+                              vk_allocator(VK_OBJECT_TYPE_SURFACE_KHR),
+                              &cx.surface) != VK_SUCCESS) {
     throw runtime_error("unable to create surface");
   };
-  cx.deletion_stack.push([this]() {
-    vkDestroySurfaceKHR(this->cx.instance, this->cx.surface, nullptr);
+  cx.deletion_queue.push([this]() {
+    vkDestroySurfaceKHR(this->cx.instance, this->cx.surface,
+                        vk_allocator(VK_OBJECT_TYPE_SURFACE_KHR));
   });
 }
 
@@ -506,8 +698,23 @@ App::SwapChainSupportDetails App::get_swapchain_support() {
   return swapchain_support_details;
 }
 
+VkPresentModeKHR App::choose_present_mode(
+    const SwapChainSupportDetails& support_details) {
+  for (auto mode : support_details.presentModes) {
+    if (mode == options.present_mode) {
+      return mode;
+    }
+  }
+  println("present mode {} isn't supported, using FIFO",
+          string_VkPresentModeKHR(options.present_mode));
+  // so recreating the swapchain doesn't say it again
+  options.present_mode = VK_PRESENT_MODE_FIFO_KHR;
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
 // creates a swapchain, from an old one, if possible
 void App::create_swapchain(Context& cx) {
+  TRACE_SCOPE("create_swapchain");
   // query formats supported by surface
   SwapChainSupportDetails swapchain_support_details = get_swapchain_support();
 
@@ -547,6 +754,9 @@ void App::create_swapchain(Context& cx) {
   QueueFamilyIndex index = find_queue_family_index(cx);
 
   VkSwapchainKHR old_swapchain = cx.swapchain;
+  cx.present_mode = choose_present_mode(swapchain_support_details);
+  // a new swapchain starts counting present ids over
+  cx.last_present_id = 0;
 
   VkSwapchainCreateInfoKHR swapchain_create_info = {
       .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -563,21 +773,22 @@ void App::create_swapchain(Context& cx) {
       // .pQueueFamilyIndices = nullptr,
       .preTransform = swapchain_support_details.capabilities.currentTransform,
       .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+      .presentMode = cx.present_mode,
       .clipped = VK_TRUE,
       .oldSwapchain = old_swapchain};
 
-  VK_CHECK(vkCreateSwapchainKHR(cx.device, &swapchain_create_info, nullptr,
+  VK_CHECK(vkCreateSwapchainKHR(cx.device, &swapchain_create_info,
+                                vk_allocator(VK_OBJECT_TYPE_SWAPCHAIN_KHR),
                                 &cx.swapchain),
            "failed to create swapchain");
 
-  // after new swapchain is created, all resources can be freed
-  // related to the old swapchain
+  // after new swapchain is created, all resources related to the old
+  // swapchain can be freed, once its pending presents are done with them.
+  // frames in flight finishing isn't enough for that
   if (old_swapchain != VK_NULL_HANDLE) {
-    for (auto& image_view : cx.swapchain_image_views) {
-      vkDestroyImageView(cx.device, image_view, nullptr);
-    }
-
-    vkDestroySwapchainKHR(cx.device, old_swapchain, nullptr);
+    cx.retired_swapchains.retire(old_swapchain,
+                                 std::move(cx.swapchain_image_views));
+    cx.swapchain_image_views.clear();
   }
 
   u32 image_count;
@@ -589,49 +800,96 @@ void App::create_swapchain(Context& cx) {
   cx.swapchain_dimensions.colorspace = swapchain_create_info.imageColorSpace;
 }
 
+// headless stand in for the swapchain and its image views
+void App::create_offscreen_targets(Context& cx) {
+  TRACE_SCOPE("create_offscreen_targets");
+  cx.swapchain_dimensions = {
+      .colorspace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+      .extent = {.width = options.width, .height = options.height},
+      .format = VK_FORMAT_B8G8R8A8_UNORM,
+  };
+  const RenderTargetDesc desc = {
+      .format = cx.swapchain_dimensions.format,
+      .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+               VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+      .aspect = VK_IMAGE_ASPECT_COLOR_BIT,
+  };
+  // one per frame in flight, so a frame never renders into an image the
+  // previous one may still be copying out of
+  for (u32 i = 0; i < cx.frames_in_flight; i++) {
+    RenderTarget* target =
+        cx.render_targets.acquire(desc, cx.swapchain_dimensions.extent);
+    cx.offscreen_targets.push_back(target);
+    cx.swapchain_images.push_back(target->image);
+    cx.swapchain_image_views.push_back(target->image_view);
+  }
+}
+
+void App::create_readback_buffer(Context& cx) {
+  TRACE_SCOPE("create_readback_buffer");
+  VkExtent2D extent = cx.swapchain_dimensions.extent;
+  VkBufferCreateInfo buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4,
+      .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+  VmaAllocationCreateInfo alloc_info = {
+      // read on the cpu, so cached memory if there is any
+      .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT |
+               VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      .usage = VMA_MEMORY_USAGE_AUTO,
+  };
+  VmaAllocationInfo allocation_info;
+  VK_CHECK(vmaCreateBuffer(cx.allocator, &buffer_info, &alloc_info,
+                           &cx.readback.buffer, &cx.readback.allocation,
+                           &allocation_info),
+           "unable to create readback buffer");
+  cx.readback.data = static_cast<uint8_t*>(allocation_info.pMappedData);
+  cx.deletion_queue.push([this]() {
+    vmaDestroyBuffer(this->cx.allocator, this->cx.readback.buffer,
+                     this->cx.readback.allocation);
+  });
+}
+
 void App::create_depth_buffer(Context& cx) {
-  cx.depth_b.format = VK_FORMAT_D32_SFLOAT;
-  VkImageCreateInfo image_info = {
-      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-      .imageType = VK_IMAGE_TYPE_2D,
-      .format = cx.depth_b.format,
-      .extent = {.width = static_cast<u32>(framebuffer_width),
-                 .height = static_cast<u32>(framebuffer_height),
-                 .depth = static_cast<u32>(1)},
-      .mipLevels = 1,
-      .arrayLayers = 1,
-      .samples = VK_SAMPLE_COUNT_1_BIT,
-      .tiling = VK_IMAGE_TILING_OPTIMAL,
+  TRACE_SCOPE("create_depth_buffer");
+  const RenderTargetDesc desc = {
+      .format = VK_FORMAT_D32_SFLOAT,
       .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .aspect = VK_IMAGE_ASPECT_DEPTH_BIT,
+      // cleared on load and discarded on store every frame
+      .transient = true,
   };
-  // see https://vkguide.dev/docs/chapter-3/depth_buffer/
-  VmaAllocationCreateInfo image_alloc_info = {};
-  image_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-  image_alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-  if (vmaCreateImage(cx.allocator, &image_info, &image_alloc_info,
-                     &cx.depth_b.image, &cx.depth_b.allocation,
-                     nullptr) != VK_SUCCESS) {
-    cerr << "error creating depth image" << endl;
+  // usually an image left over from before the resize that is still big
+  // enough
+  RenderTarget* target =
+      cx.render_targets.acquire(desc, cx.swapchain_dimensions.extent);
+  cx.depth_b = {
+      .image = target->image,
+      .image_view = target->image_view,
+      .format = target->desc.format,
+      .target = target,
   };
+}
 
-  // cx.deletion_stack.push([this]() {
-  //   vmaDestroyImage(this->cx._allocator, this->cx.depth_b.image,
-  //                   this->cx.depth_b.allocation);
-  // });
+void App::create_render_target_pool(Context& cx) {
+  TRACE_SCOPE("create_render_target_pool");
+  cx.render_targets.init(cx.device, cx.allocator,
+                         options.render_target_idle_seconds);
+  cx.deletion_queue.push([this]() { this->cx.render_targets.destroy(); });
 }
 
 void App::create_vertex_buffer(Context& cx) {
+  TRACE_SCOPE("create_vertex_buffer");
+  VkDeviceSize size = sizeof(Vertex) * cx.vertices.size();
   VkBufferCreateInfo bufferInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
-  bufferInfo.size = sizeof(Vertex) * cx.vertices.size();
+  bufferInfo.size = size;
   bufferInfo.usage =
       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
   VmaAllocationCreateInfo allocInfo = {
-      // allows host writes to memory
-      .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
-      .usage = VMA_MEMORY_USAGE_AUTO,
+      // only ever written by the upload manager's copies
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
   };
 
   VK_CHECK(vmaCreateBuffer(cx.allocator, &bufferInfo, &allocInfo,
@@ -639,18 +897,47 @@ void App::create_vertex_buffer(Context& cx) {
                            &cx.vertex_buffer.allocation, nullptr),
            "unable to create vertex buffer");
 
-  // could also just write to buffer here?
-  vmaCopyMemoryToAllocation(cx.allocator, cx.vertices.data(),
-                            cx.vertex_buffer.allocation, 0,
-                            sizeof(Vertex) * cx.vertices.size());
+  // submitted with the next flush, no need to wait for it before drawing
+  cx.uploads.upload_buffer(cx.vertex_buffer.buffer, 0, cx.vertices.data(),
+                           size);
 
-  cx.deletion_stack.push([this]() {
+  cx.deletion_queue.push([this]() {
     vmaDestroyBuffer(this->cx.allocator, this->cx.vertex_buffer.buffer,
                      this->cx.vertex_buffer.allocation);
   });
 }
 
+void App::create_frame_allocator(Context& cx) {
+  TRACE_SCOPE("create_frame_allocator");
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(cx.physical_device, &properties);
+  cx.frame_allocator.init(cx.device, cx.allocator, properties.limits,
+                          cx.frames_in_flight);
+  cx.deletion_queue.push([this]() { this->cx.frame_allocator.destroy(); });
+}
+
+void App::create_upload_manager(Context& cx) {
+  TRACE_SCOPE("create_upload_manager");
+  cx.uploads.init(cx.device, cx.allocator, cx.queue, &cx.command_pools,
+                  &cx.timeline);
+  cx.deletion_queue.push([this]() { this->cx.uploads.destroy(); });
+}
+
+void App::create_draw_list(Context& cx) {
+  TRACE_SCOPE("create_draw_list");
+  cx.draw_list.init(cx.device, cx.allocator, &cx.uploads, &cx.deletion_queue);
+  rebuild_draw_list(cx);
+  cx.deletion_queue.push([this]() { this->cx.draw_list.destroy(); });
+}
+
+void App::rebuild_draw_list(Context& cx) {
+  cx.draw_list.build(cx.draws, cx.instances, cx.timeline.last_submitted);
+  // recorded frames still point at the old buffers
+  cx.recorded_frames.invalidate();
+}
+
 void App::create_render_pass(Context& cx) {
+  TRACE_SCOPE("create_render_pass");
   vector<VkAttachmentDescription> attachments = {
       // color
       {
@@ -661,13 +948,17 @@ void App::create_render_pass(Context& cx) {
           .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
           .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
           .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-          .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+          // offscreen images are only ever copied out of
+          .finalLayout = options.headless
+                             ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                             : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
       },
       // depth
       {.format = cx.depth_b.format,
        .samples = VK_SAMPLE_COUNT_1_BIT,
        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-       .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+       // never read after the pass, lets tilers skip the write back
+       .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
@@ -697,22 +988,32 @@ void App::create_render_pass(Context& cx) {
        .pImageMemoryBarriers = nullptr},
   };
 
-  VkSubpassDependency subpass_dependencies[] = {{
-      // https://themaister.net/blog/2019/08/14/yet-another-blog-explaining-vulkan-synchronization/
-      // vk_subpass_external transitions the image layout automatically
-      // however, it makes no guarantee on when this transition happens
-      .srcSubpass = VK_SUBPASS_EXTERNAL,
-      .dstSubpass = 0,
-      // specify that we wait until the color_attachment_output stage until we
-      // make the transition.
-      .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-      .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
-                      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-      .srcAccessMask = 0,
-      .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
-                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-  }};
+  VkSubpassDependency subpass_dependencies[] = {
+      {
+          // https://themaister.net/blog/2019/08/14/yet-another-blog-explaining-vulkan-synchronization/
+          // vk_subpass_external transitions the image layout automatically
+          // however, it makes no guarantee on when this transition happens
+          .srcSubpass = VK_SUBPASS_EXTERNAL,
+          .dstSubpass = 0,
+          // specify that we wait until the color_attachment_output stage until
+          // we make the transition.
+          .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+          .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+          .srcAccessMask = 0,
+          .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                           VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+      },
+      // headless, the readback copy follows in the same command buffer
+      {
+          .srcSubpass = 0,
+          .dstSubpass = VK_SUBPASS_EXTERNAL,
+          .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+          .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+      }};
 
   VkRenderPassCreateInfo render_pass_info = {
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
@@ -720,15 +1021,17 @@ void App::create_render_pass(Context& cx) {
       .pAttachments = attachments.data(),
       .subpassCount = 1,
       .pSubpasses = subpasses,
-      .dependencyCount = 1,
+      .dependencyCount = options.headless ? 2u : 1u,
       .pDependencies = subpass_dependencies};
 
-  if (vkCreateRenderPass(cx.device, &render_pass_info, nullptr,
+  if (vkCreateRenderPass(cx.device, &render_pass_info,
+                         vk_allocator(VK_OBJECT_TYPE_RENDER_PASS),
                          &cx.render_pass) != VK_SUCCESS) {
     throw runtime_error("failed to create render pass");
   };
-  cx.deletion_stack.push([this]() {
-    vkDestroyRenderPass(this->cx.device, this->cx.render_pass, nullptr);
+  cx.deletion_queue.push([this]() {
+    vkDestroyRenderPass(this->cx.device, this->cx.render_pass,
+                        vk_allocator(VK_OBJECT_TYPE_RENDER_PASS));
   });
 }
 
@@ -755,25 +1058,18 @@ VkImageView App::create_image_view(VkImage image,
           .baseArrayLayer = 0,
           .layerCount = 1,
       }};
-  if (vkCreateImageView(cx.device, &image_view_info, nullptr, &image_view) !=
-      VK_SUCCESS) {
+  if (vkCreateImageView(cx.device, &image_view_info,
+                        vk_allocator(VK_OBJECT_TYPE_IMAGE_VIEW),
+                        &image_view) != VK_SUCCESS) {
     throw runtime_error("failed to create image view!");
   }
 
   return image_view;
 }
 
-void App::create_depth_buffer_view(Context& cx) {
-  cx.depth_b.image_view = create_image_view(cx.depth_b.image, cx.depth_b.format,
-                                            VK_IMAGE_ASPECT_DEPTH_BIT);
-  // cx.deletion_stack.push([this]() {
-  //   vkDestroyImageView(this->cx.device, this->cx.depth_b.image_view,
-  //   nullptr);
-  // });
-}
-
 // image views used at runtime during pipeline rendering
 void App::create_image_views(Context& ctx) {
+  TRACE_SCOPE("create_image_views");
   cx.swapchain_image_views.resize(cx.swapchain_images.size());
   auto i = 0;
   for (auto swapchain_image : cx.swapchain_images) {
@@ -784,130 +1080,137 @@ void App::create_image_views(Context& ctx) {
   }
 }
 
-void App::create_command_pool(Context& cx) {
+void App::create_command_pools(Context& cx) {
+  TRACE_SCOPE("create_command_pools");
   QueueFamilyIndex queue_family_index = find_queue_family_index(cx);
-
-  VkCommandPoolCreateInfo command_pool_create_info = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-      .queueFamilyIndex = queue_family_index.draw_and_present_family.value()};
-  ;
-
-  if (vkCreateCommandPool(cx.device, &command_pool_create_info, nullptr,
-                          &cx.command_pool) != VK_SUCCESS) {
-    throw runtime_error("failed to create command pool");
+  // a lane per thread that may record draws at once
+  u32 lanes = options.record_threads == 0 ? cx.workers.size() + 1
+                                          : options.record_threads;
+  cx.command_pools.init(cx.device,
+                        queue_family_index.draw_and_present_family.value(),
+                        &cx.timeline, cx.frames_in_flight, lanes);
+  cx.deletion_queue.push([this]() { this->cx.command_pools.destroy(); });
+  cx.recorder.init(&cx.command_pools);
+  cx.deletion_queue.push([this]() { this->cx.recorder.destroy(); });
+
+  if (options.reuse_command_buffers) {
+    cx.recorded_frames.init(
+        cx.device, queue_family_index.draw_and_present_family.value(),
+        cx.frames_in_flight);
+    cx.deletion_queue.push([this]() { this->cx.recorded_frames.destroy(); });
   }
-
-  cx.deletion_stack.push([this]() {
-    vkDestroyCommandPool(this->cx.device, this->cx.command_pool, nullptr);
-  });
 }
 
-void App::create_command_buffers(Context& cx) {
-  const VkCommandBufferAllocateInfo command_buffer_info = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = cx.command_pool,
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = MAX_IN_FLIGHT_FRAMES,
-  };
-
-  cx.command_buffers.resize(MAX_IN_FLIGHT_FRAMES);
-
-  // get command buffer
-  VK_CHECK(vkAllocateCommandBuffers(cx.device, &command_buffer_info,
-                                    cx.command_buffers.data()),
-           "failed to allocate command buffers");
+void App::create_gpu_timer(Context& cx) {
+  TRACE_SCOPE("create_gpu_timer");
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(cx.physical_device, &properties);
+
+  u32 family_count;
+  vkGetPhysicalDeviceQueueFamilyProperties(cx.physical_device, &family_count,
+                                           nullptr);
+  vector<VkQueueFamilyProperties> families(family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(cx.physical_device, &family_count,
+                                           families.data());
+  QueueFamilyIndex queue_family_index = find_queue_family_index(cx);
+  u32 family = queue_family_index.draw_and_present_family.value();
 
-  cx.deletion_stack.push([this]() {
-    vkFreeCommandBuffers(this->cx.device, this->cx.command_pool, 1,
-                         this->cx.command_buffers.data());
-  });
+  cx.gpu_timer.init(cx.device, properties.limits,
+                    families[family].timestampValidBits, cx.frames_in_flight);
+  cx.deletion_queue.push([this]() { this->cx.gpu_timer.destroy(); });
 }
 
 void App::create_semaphores(Context& cx) {
+  TRACE_SCOPE("create_semaphores");
   const VkSemaphoreCreateInfo unsignaled_semaphore_info = {
       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
   };
 
-  cx.semaphores.swapchain_image_is_available.resize(MAX_IN_FLIGHT_FRAMES);
-  cx.semaphores.rendering_is_complete.resize(MAX_IN_FLIGHT_FRAMES);
+  cx.semaphores.swapchain_image_is_available.resize(cx.frames_in_flight);
+  cx.semaphores.rendering_is_complete.resize(cx.frames_in_flight);
 
-  for (int i = 0; i < MAX_IN_FLIGHT_FRAMES; i++) {
-    vkCreateSemaphore(cx.device, &unsignaled_semaphore_info, nullptr,
+  for (u32 i = 0; i < cx.frames_in_flight; i++) {
+    vkCreateSemaphore(cx.device, &unsignaled_semaphore_info,
+                      vk_allocator(VK_OBJECT_TYPE_SEMAPHORE),
                       &cx.semaphores.swapchain_image_is_available[i]);
 
-    vkCreateSemaphore(cx.device, &unsignaled_semaphore_info, nullptr,
+    vkCreateSemaphore(cx.device, &unsignaled_semaphore_info,
+                      vk_allocator(VK_OBJECT_TYPE_SEMAPHORE),
                       &cx.semaphores.rendering_is_complete[i]);
 
-    cx.deletion_stack.push([i, this]() {
+    cx.deletion_queue.push([i, this]() {
       vkDestroySemaphore(this->cx.device,
                          this->cx.semaphores.swapchain_image_is_available[i],
-                         nullptr);
+                         vk_allocator(VK_OBJECT_TYPE_SEMAPHORE));
       vkDestroySemaphore(this->cx.device,
-                         this->cx.semaphores.rendering_is_complete[i], nullptr);
+                         this->cx.semaphores.rendering_is_complete[i],
+                         vk_allocator(VK_OBJECT_TYPE_SEMAPHORE));
     });
   }
 }
 
-void App::create_fences(Context& cx) {
-  const VkFenceCreateInfo signaled_fence_info = {
-      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-      .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-  };
-  const VkFenceCreateInfo unsignaled_fence_info = {
-      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-  };
-
-  cx.fences.command_buffer_can_be_used.resize(MAX_IN_FLIGHT_FRAMES);
-  cx.fences.rendering_is_complete.resize(MAX_IN_FLIGHT_FRAMES);
-
-  for (int i = 0; i < MAX_IN_FLIGHT_FRAMES; i++) {
-    vkCreateFence(cx.device, &signaled_fence_info, nullptr,
-                  &cx.fences.command_buffer_can_be_used[i]);
-
-    vkCreateFence(cx.device, &unsignaled_fence_info, nullptr,
-                  &cx.fences.rendering_is_complete[i]);
-
-    cx.deletion_stack.push([i, this]() {
-      vkDestroyFence(this->cx.device, this->cx.fences.rendering_is_complete[i],
-                     nullptr);
-      vkDestroyFence(this->cx.device,
-                     this->cx.fences.command_buffer_can_be_used[i], nullptr);
-    });
-  }
+void App::create_timeline(Context& cx) {
+  TRACE_SCOPE("create_timeline");
+  cx.timeline.init(cx.device);
+  // 0 is where the timeline starts, so waiting on it never blocks
+  cx.frame_values.assign(cx.frames_in_flight, 0);
+  cx.deletion_queue.push([this]() { this->cx.timeline.destroy(); });
 }
 
 void App::create_queue(Context& cx) {
+  TRACE_SCOPE("create_queue");
   QueueFamilyIndex queue_family_index = find_queue_family_index(cx);
   vkGetDeviceQueue(cx.device,
                    queue_family_index.draw_and_present_family.value(), 0,
                    &cx.queue);
+  // old swapchains are retired by waiting on this queue's presents
+  cx.retired_swapchains.init(cx.device, cx.queue, cx.swapchain_maintenance1);
 }
 
 void App::teardown_framebuffers(Context& cx) {
-  // since in create swapchain the destroy swapchain is already enqueued
-  for (auto& swapchain_framebuffer : cx.swapchain_framebuffers) {
-    vkDestroyFramebuffer(cx.device, swapchain_framebuffer, nullptr);
-  }
+  // since in create swapchain the destroy swapchain is already enqueued.
+  // frames in flight may still be rendering into them
+  cx.deletion_queue.defer(
+      cx.timeline.last_submitted,
+      [device = cx.device,
+       framebuffers = std::move(cx.swapchain_framebuffers)]() {
+        for (auto& swapchain_framebuffer : framebuffers) {
+          vkDestroyFramebuffer(device, swapchain_framebuffer,
+                               vk_allocator(VK_OBJECT_TYPE_FRAMEBUFFER));
+        }
+      });
+  cx.swapchain_framebuffers.clear();
 }
 
 void App::teardown_depth_buffer(Context& cx) {
-  // cleanup depth image and depth image view
-  vkDestroyImageView(cx.device, cx.depth_b.image_view, nullptr);
-  vmaDestroyImage(cx.allocator, cx.depth_b.image, cx.depth_b.allocation);
+  // back to the pool, which destroys it if it isn't reused for a while
+  cx.render_targets.release(cx.depth_b.target, cx.timeline.last_submitted);
 }
 
 void App::teardown_swapchain_and_image_views(Context& cx) {
+  if (options.headless) {
+    // the views belong to the targets, which go back to the pool
+    for (auto target : cx.offscreen_targets) {
+      cx.render_targets.release(target, cx.timeline.last_submitted);
+    }
+    cx.offscreen_targets.clear();
+    return;
+  }
   for (auto& swapchain_image_view : cx.swapchain_image_views) {
-    vkDestroyImageView(cx.device, swapchain_image_view, nullptr);
+    vkDestroyImageView(cx.device, swapchain_image_view,
+                       vk_allocator(VK_OBJECT_TYPE_IMAGE_VIEW));
   }
 
-  vkDestroySwapchainKHR(cx.device, cx.swapchain, nullptr);
+  vkDestroySwapchainKHR(cx.device, cx.swapchain,
+                        vk_allocator(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
 }
 
+// no vkDeviceWaitIdle: everything the frames in flight may still use is
+// handed to the deletion queue instead of being destroyed here
 void App::recreate_swapchain(Context& cx) {
-  VK_CHECK(vkDeviceWaitIdle(cx.device), "failed to wait for device");
-
+  TRACE_SCOPE("recreate_swapchain");
+  // recorded frames reference the old images, framebuffers and extent
+  cx.recorded_frames.invalidate();
   teardown_framebuffers(cx);
   teardown_depth_buffer(cx);
 
@@ -915,23 +1218,153 @@ void App::recreate_swapchain(Context& cx) {
   create_depth_buffer(cx);
 
   create_image_views(cx);
-  create_depth_buffer_view(cx);
 
-  create_framebuffers(cx);
+  // dynamic rendering has nothing to rebuild here, which is the point
+  if (!options.dynamic_rendering) {
+    create_framebuffers(cx);
+  }
+}
+
+void App::create_pipeline_cache(Context& cx) {
+  TRACE_SCOPE("create_pipeline_cache");
+  cx.pipeline_cache.create(
+      cx.device, cx.physical_device,
+      cx.pipeline_constructor.get_current_working_dir() / ".cache" /
+          "pipeline_cache.bin");
+  // written back right before the device goes away
+  cx.deletion_queue.push([this]() {
+    this->cx.pipeline_cache.save(this->cx.device);
+    this->cx.pipeline_cache.destroy(this->cx.device);
+  });
+}
+
+void App::create_thread_pool(Context& cx) {
+  TRACE_SCOPE("create_thread_pool");
+  cx.workers.init();
+  // workers may still hold device objects, so they have to be joined before
+  // anything they touch is torn down
+  cx.deletion_queue.push([this]() { this->cx.workers.shutdown(); });
 }
 
 void App::create_pipeline(Context& cx) {
-  cx.pipelines = cx.pipeline_constructor.create(
-      cx.device, cx.swapchain_dimensions, cx.render_pass);
-  cx.deletion_stack.push([this]() {
-    for (auto& pipeline : this->cx.pipelines) {
-      vkDestroyPipeline(this->cx.device, pipeline, nullptr);
-    };
-    this->cx.pipeline_constructor.deletion_stack.flush();
+  TRACE_SCOPE("create_pipeline");
+  cx.pipelines.init(cx.device, cx.pipeline_constructor, cx.workers,
+                    cx.render_pass, cx.pipeline_cache.cache,
+                    options.extended_dynamic_state);
+  PipelineKey key = {
+      .vertex_shader = cx.pipelines.shader_id("main.vert"),
+      .fragment_shader = cx.pipelines.shader_id("main.frag"),
+      .color_format = cx.swapchain_dimensions.format,
+      .depth_format = cx.depth_b.format,
+  };
+  DrawState state;
+  state.bake(key);
+  // builds on a worker, joined by `wait_for_pipeline`
+  cx.main_pipeline = cx.pipelines.request(key);
+  // anything requested later draws with this until its own build lands
+  cx.pipelines.fallback = cx.main_pipeline;
+
+  cx.draws.assign(options.draws,
+                  {
+                      .pipeline = cx.main_pipeline,
+                      .state = state,
+                      .vertex_count = static_cast<u32>(cx.vertices.size()),
+                  });
+
+  if (options.instances > 0) {
+    PipelineKey instanced_key = key;
+    instanced_key.vertex_shader = cx.pipelines.shader_id("instanced.vert");
+    instanced_key.vertex_layout = VertexLayout::position_color_instanced;
+    cx.instanced_pipeline = cx.pipelines.request(instanced_key);
+
+    // a square grid of shrunk copies covering the viewport, shaded across it
+    u32 side = static_cast<u32>(ceil(sqrt(options.instances)));
+    float cell = 2.f / static_cast<float>(side);
+    vector<InstanceData> instances(options.instances);
+    for (u32 i = 0; i < options.instances; i++) {
+      float u = (static_cast<float>(i % side) + .5f) / side;
+      float v = (static_cast<float>(i / side) + .5f) / side;
+      InstanceData& instance = instances[i];
+      instance.transform[0][0] = cell;
+      instance.transform[1][1] = cell;
+      instance.transform[3] = glm::vec4(u * 2.f - 1.f, v * 2.f - 1.f, 0.f, 1.f);
+      instance.color = glm::vec4(u, v, 1.f - u, 1.f);
+    }
+    add_instanced_draw(cx,
+                       {
+                           .pipeline = cx.instanced_pipeline.value(),
+                           .state = state,
+                           .vertex_count =
+                               static_cast<u32>(cx.vertices.size()),
+                       },
+                       instances);
+  }
+}
+
+void App::add_instanced_draw(Context& cx,
+                             Draw draw,
+                             const vector<InstanceData>& instances) {
+  draw.instance_count = static_cast<u32>(instances.size());
+  draw.first_instance = static_cast<u32>(cx.instances.size());
+  cx.instances.insert(cx.instances.end(), instances.begin(), instances.end());
+  cx.draws.push_back(draw);
+}
+
+void App::wait_for_pipeline(Context& cx) {
+  TRACE_SCOPE("wait_for_pipeline");
+  cx.pipelines.wait(cx.main_pipeline);
+  // the fallback would draw every instance on top of each other
+  if (cx.instanced_pipeline.has_value()) {
+    cx.pipelines.wait(cx.instanced_pipeline.value());
+  }
+  // swapped in now rather than by the first frame
+  cx.pipelines.commit(cx.timeline.last_submitted, cx.timeline.completed());
+  cx.deletion_queue.push([this]() {
+    this->cx.pipelines.destroy();
+    this->cx.pipeline_constructor.deletion_queue.flush();
   });
 }
 
+void App::start_shader_reloader(Context& cx) {
+  TRACE_SCOPE("start_shader_reloader");
+#ifdef RUNTIME_SHADER_COMPILER
+  cx.shader_reloader.start(
+      cx.pipeline_constructor.get_current_working_dir() / "shaders", [this]() {
+        this->cx.pipeline_constructor.prefer_shader_sources = true;
+        this->cx.pipelines.rebuild_all();
+      });
+  // stopped before the registry is destroyed, so no rebuild can sneak in
+  cx.deletion_queue.push([this]() { this->cx.shader_reloader.stop(); });
+#endif
+}
+
+void App::start_benchmark(Context& cx) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(cx.physical_device, &properties);
+  cx.bench.start(cx.device, cx.timeline.semaphore, properties.deviceName,
+                 options.bench_warmup, options.bench_frames);
+  cx.bench.present_mode = options.headless
+                              ? "headless"
+                              : string_VkPresentModeKHR(cx.present_mode);
+  cx.bench.frames_in_flight = cx.frames_in_flight;
+  cx.bench.present_wait = cx.present_wait;
+  cx.bench.draws = cx.draws.size();
+  cx.bench.instances = cx.instances.size();
+  cx.bench.indirect_draws = cx.indirect_draws;
+  // its thread waits on the timeline
+  cx.deletion_queue.push([this]() { this->cx.bench.stop(); });
+}
+
+void App::finish_benchmark(Context& cx) {
+  // the last few frames still have to be seen finishing
+  cx.bench.submit_latency.wait_for_all();
+  cx.bench.print();
+  cx.bench.write_json(options.bench_output, cx.swapchain_dimensions.extent,
+                      options.headless);
+}
+
 void App::create_framebuffers(Context& cx) {
+  TRACE_SCOPE("create_framebuffers");
   cx.swapchain_framebuffers.resize(cx.swapchain_image_views.size());
 
   for (size_t i = 0; i < cx.swapchain_image_views.size(); i++) {
@@ -949,7 +1382,8 @@ void App::create_framebuffers(Context& cx) {
 
     framebufferInfo.layers = 1;
 
-    if (vkCreateFramebuffer(cx.device, &framebufferInfo, nullptr,
+    if (vkCreateFramebuffer(cx.device, &framebufferInfo,
+                            vk_allocator(VK_OBJECT_TYPE_FRAMEBUFFER),
                             &cx.swapchain_framebuffers[i]) != VK_SUCCESS) {
       throw runtime_error("failed to create framebuffer!");
     }
@@ -957,130 +1391,205 @@ void App::create_framebuffers(Context& cx) {
 }
 
 void App::create_allocator() {
+  TRACE_SCOPE("create_allocator");
   // initialize the memory allocator
   VmaAllocatorCreateInfo allocatorInfo = {
+      .flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
       .physicalDevice = cx.physical_device,
       .device = cx.device,
+      // vma's own vkAllocateMemory/vkCreateBuffer/... calls, all of them
+      // counted as device memory
+      .pAllocationCallbacks = vk_allocator(VK_OBJECT_TYPE_DEVICE_MEMORY),
       .instance = cx.instance,
-      .flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
+      .vulkanApiVersion = VK_API_VERSION_1_3,
   };
+  if (cx.memory_budget_extension) {
+    allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+  }
   vmaCreateAllocator(&allocatorInfo, &cx.allocator);
-  cx.deletion_stack.push([this]() { vmaDestroyAllocator(this->cx.allocator); });
+  cx.deletion_queue.push([this]() { vmaDestroyAllocator(this->cx.allocator); });
 }
 
 void App::init_vulkan(Context& cx) {
+  TRACE_SCOPE("init_vulkan");
   // println("start init vulkan---------");
-  cx.deletion_stack.init();
+  cx.deletion_queue.init();
+  // before the instance, everything has to be freed with the callbacks it
+  // was created with
+  host_allocator.init(options.track_host_allocations,
+                      options.command_arena_size);
+  cx.frames_in_flight = options.frames_in_flight;
   create_instance(cx);
   setup_debug_messenger();
   choose_physical_device(cx);
-  create_surface(cx);
+  if (!options.headless) {
+    create_surface(cx);
+  }
 
   // and the queue as well
   create_logical_device(cx);
+  create_queue(cx);
+  // uploads signal it from the start
+  create_timeline(cx);
+  // shader compilation only needs the device, so start it as early as
+  // possible and let it run behind the rest of the setup
+  create_thread_pool(cx);
+  cx.pipeline_constructor.init(cx.device);
+  cx.pipeline_constructor.compile_shader_stages({"main.vert", "main.frag"},
+                                                cx.workers);
   create_allocator();
-  create_swapchain(cx);
+  // uploads record into them from the start
+  create_command_pools(cx);
+  create_upload_manager(cx);
+  create_frame_allocator(cx);
+  create_render_target_pool(cx);
+  create_pipeline_cache(cx);
+  if (options.headless) {
+    create_offscreen_targets(cx);
+  } else {
+    create_swapchain(cx);
+  }
+  if (!options.capture_path.empty()) {
+    create_readback_buffer(cx);
+  }
 
   create_depth_buffer(cx);
-  create_render_pass(cx);
+  // with dynamic rendering the pipelines only need the attachment formats
+  if (!options.dynamic_rendering) {
+    create_render_pass(cx);
+  }
+  create_pipeline(cx);
 
-  // needed in the render pass*
-  // * assuming no dynamic rendering
-  create_image_views(cx);
-  create_depth_buffer_view(cx);
+  // the offscreen targets come with their views
+  if (!options.headless) {
+    create_image_views(cx);
+  }
   create_vertex_buffer(cx);
-  create_framebuffers(cx);
-  create_pipeline(cx);
+  // after the draws were set up with the pipeline
+  create_draw_list(cx);
+  if (!options.dynamic_rendering) {
+    create_framebuffers(cx);
+  }
 
-  // can be created anytime after device is created
-  create_command_pool(cx);
-  create_command_buffers(cx);
+  create_gpu_timer(cx);
   // synchronization stuff
-  create_fences(cx);
   create_semaphores(cx);
-  create_queue(cx);
+  // everything queued for upload during init goes out in one batch
+  cx.uploads.flush();
+  wait_for_pipeline(cx);
+  start_shader_reloader(cx);
+  if (options.bench_frames > 0) {
+    start_benchmark(cx);
+  }
   // dbg_get_surface_output_formats();
   // println(
   //     "\n\n\n\n\n----------------------debug: done init vulkan\n\n\n\n\n\n");
 }
-void App::render_frame(Context& cx) {
-  // println("-----------------{}----------------", total_frames_rendered);
-  vkWaitForFences(cx.device, 1,
-                  &cx.fences.command_buffer_can_be_used[cx.current_frame],
-                  VK_TRUE, UINT64_MAX);
-
-  VkAcquireNextImageInfoKHR next_image_info = {
-      .sType = VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR,
-      .swapchain = cx.swapchain,
-      // wait 1 second maxinum
-      .timeout = UINT64_MAX,
-      .semaphore = cx.semaphores.swapchain_image_is_available[cx.current_frame],
-      .fence = VK_NULL_HANDLE,
-      .deviceMask = static_cast<u32>(1) << cx.physical_device_index};
 
-  u32 swapchain_image_index;
-  VkResult acquire_next_image_result = vkAcquireNextImage2KHR(
-      cx.device, &next_image_info, &swapchain_image_index);
-  if (acquire_next_image_result == VK_ERROR_OUT_OF_DATE_KHR ||
-      acquire_next_image_result == VK_SUBOPTIMAL_KHR) {
-    // delete the now invalid semaphore
-    vkDestroySemaphore(
-        cx.device, cx.semaphores.swapchain_image_is_available[cx.current_frame],
-        nullptr);
-
-    const VkSemaphoreCreateInfo unsignaled_semaphore_info = {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+void App::begin_rendering(Context& cx,
+                          VkCommandBuffer command_buffer,
+                          u32 swapchain_image_index,
+                          bool secondary_contents) {
+  const VkRect2D render_area = {.offset = {0, 0},
+                                .extent = cx.swapchain_dimensions.extent};
+
+  if (!options.dynamic_rendering) {
+    const vector<VkClearValue> clear_values = {
+        {.color = {0.0f, 0.0f, 0.0f, 0.0f}},
+        {.depthStencil = {0., 0}},
     };
 
-    vkCreateSemaphore(
-        cx.device, &unsignaled_semaphore_info, nullptr,
-        &cx.semaphores.swapchain_image_is_available[cx.current_frame]);
-
-    // recreate the swapchain
-    // println("recreating swapchain {}", current_frame);
-    recreate_swapchain(cx);
+    const VkRenderPassBeginInfo renderpassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = cx.render_pass,
+        .framebuffer = cx.swapchain_framebuffers[swapchain_image_index],
+        .renderArea = render_area,
+        .clearValueCount = static_cast<u32>(clear_values.size()),
+        .pClearValues = clear_values.data(),
+    };
+    vkCmdBeginRenderPass(command_buffer, &renderpassInfo,
+                         secondary_contents
+                             ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                             : VK_SUBPASS_CONTENTS_INLINE);
     return;
-  } else if (acquire_next_image_result != VK_SUCCESS) {
-    throw runtime_error("unable to acquire next image");
   }
 
-  vkResetFences(cx.device, 1,
-                &cx.fences.command_buffer_can_be_used[cx.current_frame]);
-
-  // get command buffer
-  VkCommandBuffer command_buffer = cx.command_buffers[cx.current_frame];
-
-  const VkCommandBufferBeginInfo command_buffer_begin_info = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-      // .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  // what the render pass did implicitly. both images are cleared, so their
+  // previous contents (and layouts) can be discarded
+  const VkImageMemoryBarrier2 barriers[] = {
+      // the acquire semaphore is waited on at color attachment output, so
+      // chaining off that stage orders the transition after the acquire
+      {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+       .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+       .srcAccessMask = VK_ACCESS_2_NONE,
+       .dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+       .dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+       .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+       .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+       .image = cx.swapchain_images[swapchain_image_index],
+       .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                            .levelCount = 1,
+                            .layerCount = 1}},
+      // the depth buffer is shared between frames in flight, so wait for
+      // the previous frame's depth writes
+      {.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+       .srcStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                       VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+       .srcAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+       .dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                       VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+       .dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+       .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+       .newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+       .image = cx.depth_b.image,
+       .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+                            .levelCount = 1,
+                            .layerCount = 1}},
   };
-
-  vkResetCommandBuffer(command_buffer, 0);
-
-  vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
-
-  // THIS IS WHERE THE MAGIC HAPPENS !!
-  // Begin Render Pass
-  const vector<VkClearValue> clear_values = {
-      {.color = {0.0f, 0.0f, 0.0f, 0.0f}},
-      {.depthStencil = {0., 0}},
+  const VkDependencyInfo dependency_info = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .imageMemoryBarrierCount = 2,
+      .pImageMemoryBarriers = barriers,
   };
-
-  const VkRenderPassBeginInfo renderpassInfo = {
-      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-      .renderPass = cx.render_pass,
-      .framebuffer = cx.swapchain_framebuffers[swapchain_image_index],
-      .renderArea = {.offset = {0, 0},
-                     .extent = cx.swapchain_dimensions.extent},
-      .clearValueCount = static_cast<u32>(clear_values.size()),
-      .pClearValues = clear_values.data(),
+  vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+
+  const VkRenderingAttachmentInfo color_attachment = {
+      .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+      .imageView = cx.swapchain_image_views[swapchain_image_index],
+      .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+      .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+      .clearValue = {.color = {0.0f, 0.0f, 0.0f, 0.0f}},
   };
-  vkCmdBeginRenderPass(command_buffer, &renderpassInfo,
-                       VK_SUBPASS_CONTENTS_INLINE);
-
-  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    cx.pipelines[0]);
+  // nothing reads depth after the frame, so it never has to leave the tile
+  const VkRenderingAttachmentInfo depth_attachment = {
+      .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+      .imageView = cx.depth_b.image_view,
+      .imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+      .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+      .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+      .clearValue = {.depthStencil = {0., 0}},
+  };
+  const VkRenderingInfo rendering_info = {
+      .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+      .flags = secondary_contents
+                   ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT
+                   : 0u,
+      .renderArea = render_area,
+      .layerCount = 1,
+      .colorAttachmentCount = 1,
+      .pColorAttachments = &color_attachment,
+      .pDepthAttachment = &depth_attachment,
+  };
+  vkCmdBeginRendering(command_buffer, &rendering_info);
+}
 
+void App::record_draws(Context& cx,
+                       VkCommandBuffer command_buffer,
+                       size_t begin,
+                       size_t end) {
+  // secondaries inherit none of this from the primary
   const VkViewport viewport = {
       .x = 0.0f,
       .y = 0.0f,
@@ -1095,55 +1604,450 @@ void App::render_frame(Context& cx) {
   };
   vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
-  vector<VkDeviceSize> offsets = {0};
-  vector<VkDeviceSize> sizes = {VK_WHOLE_SIZE};
-  vector<VkDeviceSize> strides = {sizeof(Vertex)};
-
-  vkCmdBindVertexBuffers(command_buffer, 0, 1, &cx.vertex_buffer.buffer,
-                         offsets.data());
-
-  vkCmdDraw(command_buffer, 3, 1, 0, 0);
-  vkCmdEndRenderPass(command_buffer);
-  VK_CHECK(vkEndCommandBuffer(command_buffer), "failed to end command buffer");
-
-  const VkPipelineStageFlags wait_destination_stage_masks[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-
-  const VkSubmitInfo submit_info = {
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .waitSemaphoreCount = 1,
-      .pWaitSemaphores =
-          &cx.semaphores.swapchain_image_is_available[cx.current_frame],
-      .pWaitDstStageMask = &wait_destination_stage_masks[0],
-      .commandBufferCount = 1,
-      .pCommandBuffers = &command_buffer,
-      .signalSemaphoreCount = 1,
-      .pSignalSemaphores =
-          &cx.semaphores.rendering_is_complete[cx.current_frame]};
-
-  VK_CHECK(
-      vkQueueSubmit(cx.queue, 1, &submit_info,
-                    cx.fences.command_buffer_can_be_used[cx.current_frame]),
-      "failed to submit queue");
-  ;
-
-  VkResult present_result;
-  const VkPresentInfoKHR present_info = {
-      .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-      .waitSemaphoreCount = 1,
-      .pWaitSemaphores = &cx.semaphores.rendering_is_complete[cx.current_frame],
-      .swapchainCount = 1,
-      .pSwapchains = &cx.swapchain,
-      .pImageIndices = &swapchain_image_index,
-      .pResults = &present_result};
-  vkQueuePresentKHR(cx.queue, &present_info);
-  cx.current_frame = (cx.current_frame + 1) % MAX_IN_FLIGHT_FRAMES;
+  // binding 1 is only read by instanced pipelines
+  const VkBuffer vertex_buffers[] = {cx.vertex_buffer.buffer,
+                                     cx.draw_list.instances.buffer};
+  const VkDeviceSize offsets[] = {0, 0};
+  vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, offsets);
+
+  DrawConstants constants = {.draw_data = cx.draw_list.draw_data_address};
+  DrawStateCache state_cache;
+  if (cx.indirect_draws) {
+    for (size_t i = begin; i < end; i++) {
+      const DrawList::Batch& batch = cx.draw_list.batches[i];
+      state_cache.bind_pipeline(command_buffer,
+                                cx.pipelines.get(batch.pipeline));
+      if (options.extended_dynamic_state) {
+        state_cache.set(command_buffer, batch.state);
+      }
+      // gl_DrawID starts over for every indirect draw
+      constants.first_draw = batch.first_draw;
+      vkCmdPushConstants(command_buffer,
+                         cx.pipeline_constructor.pipelineLayout,
+                         VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+                         &constants);
+      cx.draw_list.draw(command_buffer, i, cx.draw_counts);
+    }
+    return;
+  }
+  for (size_t i = begin; i < end; i++) {
+    const Draw& draw = cx.draws[i];
+    state_cache.bind_pipeline(command_buffer, cx.pipelines.get(draw.pipeline));
+    if (options.extended_dynamic_state) {
+      state_cache.set(command_buffer, draw.state);
+    }
+    constants.first_draw = static_cast<u32>(i);
+    vkCmdPushConstants(command_buffer, cx.pipeline_constructor.pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+                       &constants);
+    vkCmdDraw(command_buffer, draw.vertex_count, draw.instance_count,
+              draw.first_vertex, draw.first_instance);
+  }
+}
+
+void App::end_rendering(Context& cx,
+                        VkCommandBuffer command_buffer,
+                        u32 swapchain_image_index) {
+  if (!options.dynamic_rendering) {
+    vkCmdEndRenderPass(command_buffer);
+    return;
+  }
+
+  vkCmdEndRendering(command_buffer);
+
+  // presentation is ordered by the rendering_is_complete semaphore, the
+  // barrier only has to make the writes available and change the layout.
+  // headless, the readback copy is recorded right after and has to wait
+  const VkImageMemoryBarrier2 to_present = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+      .srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+      .dstStageMask = options.headless ? VK_PIPELINE_STAGE_2_COPY_BIT
+                                       : VK_PIPELINE_STAGE_2_NONE,
+      .dstAccessMask = options.headless ? VK_ACCESS_2_TRANSFER_READ_BIT
+                                        : VK_ACCESS_2_NONE,
+      .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      .newLayout = options.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                    : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+      .image = cx.swapchain_images[swapchain_image_index],
+      .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .levelCount = 1,
+                           .layerCount = 1},
+  };
+  const VkDependencyInfo dependency_info = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .imageMemoryBarrierCount = 1,
+      .pImageMemoryBarriers = &to_present,
+  };
+  vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+void App::record_readback(Context& cx,
+                          VkCommandBuffer command_buffer,
+                          u32 swapchain_image_index) {
+  // end_rendering left the image in transfer src layout
+  const VkBufferImageCopy region = {
+      .bufferOffset = 0,
+      // tightly packed
+      .bufferRowLength = 0,
+      .bufferImageHeight = 0,
+      .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                           .mipLevel = 0,
+                           .baseArrayLayer = 0,
+                           .layerCount = 1},
+      .imageOffset = {0, 0, 0},
+      // the pooled image may be bigger than what was rendered
+      .imageExtent = {.width = cx.swapchain_dimensions.extent.width,
+                      .height = cx.swapchain_dimensions.extent.height,
+                      .depth = 1},
+  };
+  vkCmdCopyImageToBuffer(command_buffer,
+                         cx.swapchain_images[swapchain_image_index],
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         cx.readback.buffer, 1, &region);
+
+  // the timeline wait only covers host reads of writes made available to
+  // the host
+  const VkBufferMemoryBarrier2 to_host = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+      .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+      .buffer = cx.readback.buffer,
+      .offset = 0,
+      .size = VK_WHOLE_SIZE,
+  };
+  const VkDependencyInfo dependency_info = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .bufferMemoryBarrierCount = 1,
+      .pBufferMemoryBarriers = &to_host,
+  };
+  vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+void App::write_capture(Context& cx) {
+  // the captured frame is the last one submitted
+  cx.timeline.wait(cx.timeline.last_submitted);
+  vmaInvalidateAllocation(cx.allocator, cx.readback.allocation, 0,
+                          VK_WHOLE_SIZE);
+  VkExtent2D extent = cx.swapchain_dimensions.extent;
+  write_ppm(options.capture_path, cx.readback.data, extent,
+            static_cast<size_t>(extent.width) * 4);
+  println("wrote frame {} to {}", cx.frame_number - 1,
+          options.capture_path.string());
+}
+
+void App::record_frame(Context& cx,
+                       VkCommandBuffer command_buffer,
+                       u32 swapchain_image_index,
+                       bool parallel) {
+  // this slot's previous frame is done, so its timestamps are too
+  if (cx.gpu_timer.begin_frame(command_buffer, cx.current_frame,
+                               cx.frame_number) &&
+      options.bench_frames > 0) {
+    cx.bench.gpu_times(cx.gpu_timer.results);
+  }
+  u32 frame_span = cx.gpu_timer.begin(command_buffer, "frame");
+  u32 pass_span = cx.gpu_timer.begin(command_buffer, "main pass");
+
+  // big draw lists are recorded in parallel into secondaries
+  size_t draw_calls =
+      cx.indirect_draws ? cx.draw_list.batches.size() : cx.draws.size();
+  u32 chunks = parallel ? cx.recorder.chunk_count(draw_calls) : 1;
+
+  // THIS IS WHERE THE MAGIC HAPPENS !!
+  begin_rendering(cx, command_buffer, swapchain_image_index, chunks > 1);
+
+  if (chunks > 1) {
+    // nothing but vkCmdExecuteCommands is allowed in the pass now, so the
+    // draws have no gpu timer span of their own
+    const VkCommandBufferInheritanceRenderingInfo rendering_inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &cx.swapchain_dimensions.format,
+        .depthAttachmentFormat = cx.depth_b.format,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    const VkCommandBufferInheritanceInfo inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = options.dynamic_rendering ? &rendering_inheritance : nullptr,
+        .renderPass =
+            options.dynamic_rendering ? VK_NULL_HANDLE : cx.render_pass,
+        .subpass = 0,
+        .framebuffer = options.dynamic_rendering
+                           ? VK_NULL_HANDLE
+                           : cx.swapchain_framebuffers[swapchain_image_index],
+    };
+    vector<VkCommandBuffer> secondaries = cx.recorder.record(
+        inheritance, draw_calls,
+        [&](VkCommandBuffer secondary, size_t begin, size_t end) {
+          record_draws(cx, secondary, begin, end);
+        });
+    vkCmdExecuteCommands(command_buffer, static_cast<u32>(secondaries.size()),
+                         secondaries.data());
+  } else {
+    u32 draws_span = cx.gpu_timer.begin(command_buffer, "draws");
+    record_draws(cx, command_buffer, 0, draw_calls);
+    cx.gpu_timer.end(command_buffer, draws_span);
+  }
+  end_rendering(cx, command_buffer, swapchain_image_index);
+  cx.gpu_timer.end(command_buffer, pass_span);
+  if (capture_frame) {
+    u32 readback_span = cx.gpu_timer.begin(command_buffer, "readback");
+    record_readback(cx, command_buffer, swapchain_image_index);
+    cx.gpu_timer.end(command_buffer, readback_span);
+  }
+  cx.gpu_timer.end(command_buffer, frame_span);
+}
+
+void App::wait_for_frame(Context& cx) {
+  if (cx.present_wait && cx.last_present_id >= cx.frames_in_flight) {
+    TRACE_SCOPE("wait for present");
+    // the frame `frames_in_flight` back has to be on screen, so at most that
+    // many are queued between input and display
+    u64 present_id = cx.last_present_id + 1 - cx.frames_in_flight;
+    // bounded, a minimized window may never present again. out of date is
+    // handled by the next acquire
+    VkResult result = cx.wait_for_present(cx.device, cx.swapchain, present_id,
+                                          100'000'000);
+    VK_CHECK_CONDITIONAL(result, "failed to wait for present",
+                         {VK_TIMEOUT, VK_SUBOPTIMAL_KHR,
+                          VK_ERROR_OUT_OF_DATE_KHR});
+  }
+  TRACE_SCOPE("wait for frame slot");
+  cx.timeline.wait(cx.frame_values[cx.current_frame]);
+}
+
+void App::render_frame(Context& cx) {
+  // println("-----------------{}----------------", total_frames_rendered);
+
+  // the previous frame in this slot finished, and maybe later submissions
+  // as well. anything whose last use is behind that can go
+  u64 completed = cx.timeline.completed();
+  cx.deletion_queue.collect(completed);
+  cx.render_targets.collect(completed);
+
+  // no vulkan call from the last frame is still running on this thread
+  host_allocator.begin_frame();
+
+  // vma refreshes its cached budget once per frame index
+  vmaSetCurrentFrameIndex(cx.allocator, static_cast<u32>(cx.frame_number));
+
+  // this slot's previous frame is done with its transient data
+  cx.frame_allocator.begin_frame(cx.current_frame);
+  // and with its command buffers
+  cx.command_pools.begin_frame(cx.current_frame);
+  if (cx.indirect_draws) {
+    cx.draw_counts = cx.draw_list.write_counts(cx.frame_allocator);
+  }
+
+  // every frame that could still be using a retired pipeline is done
+  if (cx.pipelines.commit(cx.timeline.last_submitted, completed)) {
+    println("swapped in rebuilt pipelines");
+    cx.recorded_frames.invalidate();
+  }
+
+  u32 swapchain_image_index;
+  bool swapchain_is_stale = false;
+  if (options.headless) {
+    // the slot wait above covered this image's last use
+    swapchain_image_index = cx.current_frame;
+  } else {
+    TRACE_SCOPE("acquire");
+    VkAcquireNextImageInfoKHR next_image_info = {
+        .sType = VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR,
+        .swapchain = cx.swapchain,
+        // wait 1 second maxinum
+        .timeout = UINT64_MAX,
+        .semaphore =
+            cx.semaphores.swapchain_image_is_available[cx.current_frame],
+        .fence = VK_NULL_HANDLE,
+        .deviceMask = static_cast<u32>(1) << cx.physical_device_index};
+
+    VkResult acquire_next_image_result = vkAcquireNextImage2KHR(
+        cx.device, &next_image_info, &swapchain_image_index);
+    if (acquire_next_image_result == VK_ERROR_OUT_OF_DATE_KHR) {
+      // nothing was acquired, so the semaphore was never signaled and can be
+      // used again as is
+      recreate_swapchain(cx);
+      return;
+    } else if (acquire_next_image_result != VK_SUCCESS &&
+               acquire_next_image_result != VK_SUBOPTIMAL_KHR) {
+      throw runtime_error("unable to acquire next image");
+    }
+    // a suboptimal image is still acquired (and the semaphore signaled), so
+    // render and present it and recreate afterwards
+    swapchain_is_stale = acquire_next_image_result == VK_SUBOPTIMAL_KHR;
+  }
+
+  // a frame recorded earlier for this slot and image is submitted again as
+  // long as nothing it records changed. the capture frame adds a readback,
+  // so it always records from scratch
+  RecordedFrames::Entry* cached = nullptr;
+  if (options.reuse_command_buffers && !capture_frame) {
+    cached =
+        &cx.recorded_frames.entry(cx.current_frame, swapchain_image_index);
+  }
+
+  VkCommandBuffer command_buffer;
+  // the recorded draws read their counts from where this frame's are
+  if (cached != nullptr && cx.recorded_frames.is_current(*cached) &&
+      cached->frame_data_offset == cx.draw_counts.offset) {
+    command_buffer = cached->command_buffer;
+    cx.recorded_frames.replays++;
+    if (cx.gpu_timer.replay_frame(cx.current_frame, cx.frame_number,
+                                  cached->gpu_spans) &&
+        options.bench_frames > 0) {
+      cx.bench.gpu_times(cx.gpu_timer.results);
+    }
+  } else {
+    // from the frame's pools, reset in begin_frame, unless it's kept
+    command_buffer =
+        cached != nullptr
+            ? cached->command_buffer
+            : cx.command_pools.allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+    const VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = cached != nullptr
+                     ? 0u
+                     : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+
+    TraceScope record("record");
+    // implicitly resets a kept command buffer
+    vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+    // secondaries from the frame's pools would be reset under a kept
+    // command buffer, so it records its draws inline
+    record_frame(cx, command_buffer, swapchain_image_index,
+                 cached == nullptr);
+    VK_CHECK(vkEndCommandBuffer(command_buffer),
+             "failed to end command buffer");
+    record.end();
+    if (cached != nullptr) {
+      cx.recorded_frames.recorded(*cached,
+                                  cx.gpu_timer.frames[cx.current_frame].names,
+                                  cx.draw_counts.offset);
+    }
+  }
+
+  TraceScope submit("submit");
+  // anything uploaded while recording has to land ahead of this frame
+  cx.uploads.flush();
+  cx.frame_allocator.flush_frame();
+
+  const VkSemaphoreSubmitInfo wait_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .semaphore = cx.semaphores.swapchain_image_is_available[cx.current_frame],
+      .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT};
+  const VkCommandBufferSubmitInfo command_buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .commandBuffer = command_buffer};
+  // the timeline value first, so headless can drop the present semaphore
+  u64 frame_value = cx.timeline.next();
+  const VkSemaphoreSubmitInfo signal_infos[] = {
+      cx.timeline.signal_info(frame_value),
+      {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+       .semaphore = cx.semaphores.rendering_is_complete[cx.current_frame],
+       .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT}};
+
+  // headless there's no image to wait for and no present to signal
+  const VkSubmitInfo2 submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .waitSemaphoreInfoCount = options.headless ? 0u : 1u,
+      .pWaitSemaphoreInfos = &wait_info,
+      .commandBufferInfoCount = 1,
+      .pCommandBufferInfos = &command_buffer_info,
+      .signalSemaphoreInfoCount = options.headless ? 1u : 2u,
+      .pSignalSemaphoreInfos = signal_infos};
+
+  auto submitted_at = chrono::steady_clock::now();
+  VK_CHECK(vkQueueSubmit2(cx.queue, 1, &submit_info, VK_NULL_HANDLE),
+           "failed to submit queue");
+  cx.frame_values[cx.current_frame] = frame_value;
+  cx.command_pools.submitted(frame_value);
+  if (options.bench_frames > 0) {
+    cx.bench.submit_latency.submitted(frame_value, submitted_at,
+                                      cx.bench.recording);
+    cx.bench.input_latency(input_sampled_at, submitted_at);
+  }
+  submit.end();
+
+  VkResult queue_present_result = VK_SUCCESS;
+  if (!options.headless) {
+    TRACE_SCOPE("present");
+    VkResult present_result;
+    // tells `retired_swapchains` when the presentation engine is done
+    VkFence present_fence = cx.retired_swapchains.present_fence();
+    const VkSwapchainPresentFenceInfoEXT present_fence_info = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT,
+        .swapchainCount = 1,
+        .pFences = &present_fence};
+    const void* present_fence_next =
+        present_fence != VK_NULL_HANDLE ? &present_fence_info : nullptr;
+    u64 present_id = ++cx.last_present_id;
+    const VkPresentIdKHR present_id_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext = present_fence_next,
+        .swapchainCount = 1,
+        .pPresentIds = &present_id};
+    const VkPresentInfoKHR present_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .pNext = cx.present_wait ? &present_id_info : present_fence_next,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores =
+            &cx.semaphores.rendering_is_complete[cx.current_frame],
+        .swapchainCount = 1,
+        .pSwapchains = &cx.swapchain,
+        .pImageIndices = &swapchain_image_index,
+        .pResults = &present_result};
+    queue_present_result = vkQueuePresentKHR(cx.queue, &present_info);
+    cx.retired_swapchains.presented();
+  }
+  cx.current_frame = (cx.current_frame + 1) % cx.frames_in_flight;
+  cx.frame_number++;
+
+  if (swapchain_is_stale ||
+      queue_present_result == VK_ERROR_OUT_OF_DATE_KHR ||
+      queue_present_result == VK_SUBOPTIMAL_KHR) {
+    recreate_swapchain(cx);
+  } else {
+    VK_CHECK(queue_present_result, "failed to present");
+  }
 }
 void App::main_loop() {
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  u64 frame_limit = options.frames;
+  if (options.headless && frame_limit == 0) {
+    frame_limit = 1;
+  }
+  if (options.bench_frames > 0) {
+    frame_limit = options.bench_warmup + options.bench_frames;
+  }
+  while (frame_limit == 0 || total_frames_rendered < frame_limit) {
+    TRACE_SCOPE("frame");
+    // waiting after polling would leave the input to go stale
+    wait_for_frame(cx);
+    if (!options.headless) {
+      glfwPollEvents();
+      if (glfwWindowShouldClose(window)) {
+        break;
+      }
+    }
+    input_sampled_at = chrono::steady_clock::now();
 
+    capture_frame = !options.capture_path.empty() &&
+                    total_frames_rendered + 1 == frame_limit;
+    auto frame_start = chrono::steady_clock::now();
     render_frame(cx);
+    if (options.bench_frames > 0) {
+      cx.bench.frame(frame_start, chrono::steady_clock::now());
+    }
+    report_memory(cx);
+    if (gpu_times_requested) {
+      gpu_times_requested = false;
+      cx.gpu_timer.print();
+    }
 
     // VK_CHECK(present_result, "failed to present");
     total_frames_rendered += 1;
@@ -1152,31 +2056,88 @@ void App::main_loop() {
     //   return;
     // }
   }
+  if (options.bench_frames > 0) {
+    finish_benchmark(cx);
+  }
+  if (!options.capture_path.empty()) {
+    write_capture(cx);
+  }
+}
+void App::report_memory(Context& cx) {
+  if (memory_stats_requested) {
+    memory_stats_requested = false;
+    path file = options.memory_stats_path.empty() ? path("memory_stats.json")
+                                                  : options.memory_stats_path;
+    MemoryStats::collect(cx.allocator, cx.memory_budget_extension,
+                         cx.frame_number)
+        .write_json(file, cx.allocator);
+  }
+
+  if (options.memory_report_interval <= 0) {
+    return;
+  }
+  auto now = chrono::steady_clock::now();
+  if (now - cx.last_memory_report <
+      chrono::duration<double>(options.memory_report_interval)) {
+    return;
+  }
+  cx.last_memory_report = now;
+  MemoryStats::collect(cx.allocator, cx.memory_budget_extension,
+                       cx.frame_number)
+      .print_summary();
+  cx.command_pools.print_stats();
 }
+
 void App::destroy_debug_messenger(Context& cx) {
   if (!enableValidationLayers) {
     return;
   }
   // debug messenger must exist
-  DestroyDebugUtilsMessengerEXT(cx.instance, cx.debug_messenger, nullptr);
+  DestroyDebugUtilsMessengerEXT(
+      cx.instance, cx.debug_messenger,
+      vk_allocator(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT));
 }
 void App::teardown() {
   // println("------------------begin cleanup---------------------");
   // wait until last semaphore/fence runs
   vkDeviceWaitIdle(cx.device);
+  if (!options.memory_stats_path.empty()) {
+    MemoryStats::collect(cx.allocator, cx.memory_budget_extension,
+                         cx.frame_number)
+        .write_json(options.memory_stats_path, cx.allocator);
+  }
   // since the swapchain is created and destroyed potentially many times
   // at game time, it needs to be manually tracked.
   teardown_framebuffers(cx);
+  cx.retired_swapchains.destroy();
   teardown_swapchain_and_image_views(cx);
   teardown_depth_buffer(cx);
 
-  cx.deletion_stack.flush();
+  if (options.track_host_allocations) {
+    // while the pools are still around to report on
+    cx.command_pools.print_stats();
+  }
+  if (options.reuse_command_buffers) {
+    cx.recorded_frames.print_stats();
+  }
+  cx.deletion_queue.flush();
+  // everything is destroyed, whatever is still live leaked
+  host_allocator.print_report();
+  // the thread pools are joined, so no thread is still recording
+  if (!options.trace_path.empty()) {
+    tracer.write(options.trace_path);
+  }
 
-  glfwDestroyWindow(window);
-  glfwTerminate();
+  if (!options.headless) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
 }
 
 void App::run() {
+  if (!options.trace_path.empty()) {
+    tracer.start();
+  }
   init_window(cx);
   init_game(cx);
   init_vulkan(cx);
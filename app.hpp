@@ -1,7 +1,27 @@
 #pragma once
 
+#include "bench.hpp"
+#include "command_pools.hpp"
+#include "draw_list.hpp"
+#include "draw_state.hpp"
+#include "frame_allocator.hpp"
+#include "gpu_timer.hpp"
+#include "host_allocator.hpp"
+#include "memory_stats.hpp"
 #include "lib.hpp"
+#include "options.hpp"
+#include "parallel_recorder.hpp"
 #include "pipeline.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_registry.hpp"
+#include "ppm.hpp"
+#include "recorded_frames.hpp"
+#include "render_target_pool.hpp"
+#include "retired_swapchains.hpp"
+#include "shader_reloader.hpp"
+#include "timeline.hpp"
+#include "trace.hpp"
+#include "upload.hpp"
 
 class App {
  public:
@@ -10,16 +30,12 @@ class App {
     vector<VkSemaphore> rendering_is_complete;
   };
 
-  struct Fences {
-    vector<VkFence> command_buffer_can_be_used;
-    vector<VkFence> rendering_is_complete;
-  };
-
   struct DepthBuffer {
     VkImage image;
     VkImageView image_view;
     VkFormat format;
-    VmaAllocation allocation;
+    // owned by the render target pool, possibly larger than the swapchain
+    RenderTarget* target;
   };
 
   struct VertexBuffer {
@@ -27,6 +43,13 @@ class App {
     VmaAllocation allocation;
   };
 
+  // host visible copy of a headless frame
+  struct ReadbackBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    uint8_t* data = nullptr;
+  };
+
   struct QueueFamilyIndex {
     std::optional<u32> draw_and_present_family;
     bool isComplete() { return draw_and_present_family.has_value(); };
@@ -48,29 +71,81 @@ class App {
     VkRenderPass render_pass = VK_NULL_HANDLE;
     SwapchainDimensions swapchain_dimensions;
     VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    // VK_KHR_present_wait pacing, when asked for and supported
+    bool present_wait = false;
+    PFN_vkWaitForPresentKHR wait_for_present = nullptr;
+    // ids are per swapchain, this is the last one passed to present
+    u64 last_present_id = 0;
     // per-frame
     vector<VkImage> swapchain_images;
     // per-frame
     vector<VkImageView> swapchain_image_views;
     // per-frame
     vector<VkFramebuffer> swapchain_framebuffers;
-    VkCommandPool command_pool = VK_NULL_HANDLE;
-    // per-frame
-    vector<VkCommandBuffer> command_buffers;
+    // headless only, one per frame in flight. their images and views stand
+    // in for the swapchain's
+    vector<RenderTarget*> offscreen_targets;
+    ReadbackBuffer readback;
+    // replaced swapchains the presentation engine may still be using
+    RetiredSwapchains retired_swapchains;
+    // VK_EXT_surface_maintenance1 and VK_EXT_swapchain_maintenance1, which
+    // let presents signal a fence
+    bool surface_maintenance1 = false;
+    bool swapchain_maintenance1 = false;
+    // every command buffer comes from here, reset per frame
+    FrameCommandPools command_pools;
+    // --reuse-command-buffers. whatever changes the draws or what they
+    // reference (pipelines, vertex buffer, swapchain) invalidates it
+    RecordedFrames recorded_frames;
+    // secondary command buffers for big draw lists
+    ParallelRecorder recorder;
+    GpuTimer gpu_timer;
     VkQueue queue = VK_NULL_HANDLE;
+    ThreadPool workers;
     Pipeline pipeline_constructor;
-    vector<VkPipeline> pipelines = {VK_NULL_HANDLE};
+    PipelineCache pipeline_cache;
+    PipelineRegistry pipelines;
+    PipelineHandle main_pipeline = 0;
+    // VertexLayout::position_color_instanced, --instances only
+    optional<PipelineHandle> instanced_pipeline;
+    ShaderReloader shader_reloader;
     Semaphores semaphores;
-    Fences fences;
+    // cpu-gpu synchronization for every submission to `queue`
+    Timeline timeline;
+    // per-frame, the timeline value its last submission signals
+    vector<u64> frame_values;
     //
     VmaAllocator allocator;
+    bool memory_budget_extension = false;
+    chrono::steady_clock::time_point last_memory_report;
+    UploadManager uploads;
+    // transient per-frame data, one slice per frame in flight
+    FrameAllocator frame_allocator;
+    RenderTargetPool render_targets;
     DepthBuffer depth_b;
     vector<Vertex> vertices;
     VertexBuffer vertex_buffer;
+    vector<Draw> draws;
+    // what instanced draws in `draws` refer to
+    vector<InstanceData> instances;
+    // `draws` on the gpu, rebuilt whenever they change
+    DrawList draw_list;
+    // --indirect-draws, when vkCmdDrawIndirectCount is supported
+    bool indirect_draws = false;
+    // this frame's batch draw counts, in its frame allocator slice
+    FrameAllocation draw_counts;
+    // --bench only
+    Benchmark bench;
     //
-    DeletionStack deletion_stack;
+    DeletionQueue deletion_queue;
     VkDebugUtilsMessengerEXT debug_messenger;
+    // how many frames the cpu may run ahead of the gpu, sizes every per-frame
+    // array. at most MAX_IN_FLIGHT_FRAMES
+    u32 frames_in_flight = 2;
     u32 current_frame = 0;
+    // number of frames submitted so far, never wraps unlike `current_frame`
+    u64 frame_number = 0;
   };
 
   GLFWwindow* window;
@@ -79,6 +154,14 @@ class App {
   int framebuffer_width;
   int framebuffer_height;
   u32 total_frames_rendered = 0;
+  // set by F9 and F10, handled between frames
+  bool memory_stats_requested = false;
+  bool gpu_times_requested = false;
+  // copy the frame being recorded into `cx.readback`
+  bool capture_frame = false;
+  // when this frame's input was polled, for input to submit latency
+  chrono::steady_clock::time_point input_sampled_at;
+  Options options;
   Context cx;
 
   void run();
@@ -88,6 +171,11 @@ class App {
   static void window_size_callback(GLFWwindow* window,
                                    int new_width,
                                    int new_height);
+  static void key_callback(GLFWwindow* window,
+                           int key,
+                           int scancode,
+                           int action,
+                           int mods);
   void initialize_event_listeners(Context& cx);
   void init_window(Context& cx);
   void init_game(Context& cx);
@@ -114,34 +202,85 @@ class App {
   void dbg_get_surface_output_formats(Context& cx);
   QueueFamilyIndex find_queue_family_index(Context& cx);
   bool device_includes_extensions();
+  bool device_supports_extension(Context& cx, const char* name);
+  bool instance_supports_extension(const char* name);
   bool is_device_suitable(Context& cx);
   void create_logical_device(Context& cx);
   SwapChainSupportDetails get_swapchain_support();
   void create_surface(Context& cx);
   void create_swapchain(Context& cx);
+  VkPresentModeKHR choose_present_mode(
+      const SwapChainSupportDetails& support_details);
+  void create_offscreen_targets(Context& cx);
+  void create_readback_buffer(Context& cx);
   void create_depth_buffer(Context& cx);
+  void create_render_target_pool(Context& cx);
   void create_vertex_buffer(Context& cx);
+  void create_draw_list(Context& cx);
+  // appends a single draw of `instances.size()` copies of `draw`'s mesh,
+  // each with its own transform and color. `draw.pipeline` has to use
+  // VertexLayout::position_color_instanced
+  void add_instanced_draw(Context& cx,
+                          Draw draw,
+                          const vector<InstanceData>& instances);
+  // after changing `cx.draws` or `cx.instances`, takes effect next frame
+  void rebuild_draw_list(Context& cx);
+  void create_upload_manager(Context& cx);
+  void create_frame_allocator(Context& cx);
   void create_render_pass(Context& cx);
   VkImageView create_image_view(VkImage image,
                                 VkFormat format,
                                 VkImageAspectFlags flags);
-  void create_depth_buffer_view(Context& cx);
   void create_image_views(Context& ctx);
-  void create_command_pool(Context& cx);
-  void create_command_buffers(Context& cx);
+  void create_command_pools(Context& cx);
+  void create_gpu_timer(Context& cx);
   void create_semaphores(Context& cx);
-  void create_fences(Context& cx);
+  void create_timeline(Context& cx);
   void create_queue(Context& cx);
   void teardown_framebuffers(Context& cx);
   void teardown_depth_buffer(Context& cx);
   void teardown_swapchain_and_image_views(Context& cx);
   void recreate_swapchain(Context& cx);
+  void create_pipeline_cache(Context& cx);
+  void create_thread_pool(Context& cx);
   void create_pipeline(Context& cx);
+  void wait_for_pipeline(Context& cx);
+  void start_shader_reloader(Context& cx);
+  void start_benchmark(Context& cx);
+  void finish_benchmark(Context& cx);
   void create_framebuffers(Context& cx);
   void create_allocator();
   void init_vulkan(Context& cx);
+  // `secondary_contents`: the pass is recorded in secondary command buffers
+  void begin_rendering(Context& cx,
+                       VkCommandBuffer command_buffer,
+                       u32 swapchain_image_index,
+                       bool secondary_contents);
+  // draws [begin, end) of `cx.draws`, or of the draw list's batches when
+  // drawing indirect, with the state they need set up front
+  void record_draws(Context& cx,
+                    VkCommandBuffer command_buffer,
+                    size_t begin,
+                    size_t end);
+  void end_rendering(Context& cx,
+                     VkCommandBuffer command_buffer,
+                     u32 swapchain_image_index);
+  void record_readback(Context& cx,
+                       VkCommandBuffer command_buffer,
+                       u32 swapchain_image_index);
+  void write_capture(Context& cx);
+  // the whole frame into a begun command buffer. `parallel`: big draw lists
+  // may go to secondaries from this frame's pools
+  void record_frame(Context& cx,
+                    VkCommandBuffer command_buffer,
+                    u32 swapchain_image_index,
+                    bool parallel);
+  // blocks until the next frame may start, before its input is sampled
+  void wait_for_frame(Context& cx);
   void render_frame(Context& cx);
   void main_loop();
+  // F9 dumps and the periodic per-heap summary
+  void report_memory(Context& cx);
   void destroy_debug_messenger(Context& cx);
   void teardown();
 };
\ No newline at end of file
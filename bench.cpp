@@ -0,0 +1,235 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+static double milliseconds(chrono::steady_clock::duration duration) {
+  return chrono::duration<double, milli>(duration).count();
+}
+
+SampleSummary SampleSummary::of(vector<double> samples) {
+  SampleSummary summary = {.count = samples.size()};
+  if (samples.empty()) {
+    return summary;
+  }
+  sort(samples.begin(), samples.end());
+  auto percentile = [&](double p) {
+    size_t rank = static_cast<size_t>(ceil(p / 100.0 * samples.size()));
+    return samples[std::max<size_t>(rank, 1) - 1];
+  };
+  summary.mean =
+      accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+  summary.p50 = percentile(50);
+  summary.p95 = percentile(95);
+  summary.p99 = percentile(99);
+  summary.max = samples.back();
+  return summary;
+}
+
+string SampleSummary::to_json() const {
+  return fmt::format(
+      "{{\"count\": {}, \"mean\": {:.4f}, \"p50\": {:.4f}, \"p95\": {:.4f}, "
+      "\"p99\": {:.4f}, \"max\": {:.4f}}}",
+      count, mean, p50, p95, p99, max);
+}
+
+void SubmitLatencyProbe::start(VkDevice device, VkSemaphore timeline) {
+  this->device = device;
+  this->timeline = timeline;
+  stopping = false;
+  waiter = thread([this]() { this->work(); });
+}
+
+void SubmitLatencyProbe::stop() {
+  {
+    lock_guard lock(submissions_mutex);
+    stopping = true;
+  }
+  submissions_changed.notify_all();
+  if (waiter.joinable()) {
+    waiter.join();
+  }
+}
+
+void SubmitLatencyProbe::submitted(
+    u64 timeline_value,
+    chrono::steady_clock::time_point submitted_at,
+    bool record) {
+  {
+    lock_guard lock(submissions_mutex);
+    pending.push_back({.timeline_value = timeline_value,
+                       .submitted_at = submitted_at,
+                       .record = record});
+    submitted_count++;
+  }
+  submissions_changed.notify_all();
+}
+
+void SubmitLatencyProbe::wait_for_all() {
+  unique_lock lock(submissions_mutex);
+  u64 submission = submitted_count;
+  submissions_changed.wait(
+      lock, [&]() { return observed_count >= submission; });
+}
+
+void SubmitLatencyProbe::work() {
+  while (true) {
+    Submission submission;
+    {
+      unique_lock lock(submissions_mutex);
+      submissions_changed.wait(
+          lock, [this]() { return stopping || !pending.empty(); });
+      // every submitted value is reached eventually, so drain before exiting
+      if (pending.empty()) {
+        return;
+      }
+      submission = pending.front();
+    }
+    // timeline semaphores can be waited on from any thread, and never
+    // reset, so the frame loop doesn't have to know about this wait
+    VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &timeline,
+        .pValues = &submission.timeline_value,
+    };
+    vkWaitSemaphores(device, &wait_info, UINT64_MAX);
+    auto signaled_at = chrono::steady_clock::now();
+    {
+      lock_guard lock(submissions_mutex);
+      pending.pop_front();
+      observed_count++;
+      if (submission.record) {
+        latency_ms.push_back(
+            milliseconds(signaled_at - submission.submitted_at));
+      }
+    }
+    submissions_changed.notify_all();
+  }
+}
+
+void Benchmark::start(VkDevice device,
+                      VkSemaphore timeline,
+                      const string& device_name,
+                      u64 warmup_frames,
+                      u64 frames) {
+  this->device_name = device_name;
+  this->warmup_frames = warmup_frames;
+  this->frames = frames;
+  recording = warmup_frames == 0;
+  cpu_ms.reserve(frames);
+  interval_ms.reserve(frames);
+  input_ms.reserve(frames);
+  submit_latency.start(device, timeline);
+}
+
+void Benchmark::stop() {
+  submit_latency.stop();
+}
+
+void Benchmark::frame(chrono::steady_clock::time_point start,
+                      chrono::steady_clock::time_point end) {
+  if (recording) {
+    if (cpu_ms.empty()) {
+      recording_started = start;
+    } else {
+      interval_ms.push_back(milliseconds(start - previous_frame_start));
+    }
+    cpu_ms.push_back(milliseconds(end - start));
+    last_frame_end = end;
+  }
+  previous_frame_start = start;
+  frames_seen++;
+  recording = frames_seen >= warmup_frames;
+}
+
+void Benchmark::input_latency(
+    chrono::steady_clock::time_point input_sampled_at,
+    chrono::steady_clock::time_point submitted_at) {
+  if (recording) {
+    input_ms.push_back(milliseconds(submitted_at - input_sampled_at));
+  }
+}
+
+void Benchmark::gpu_times(const vector<GpuSpan>& spans) {
+  if (!recording) {
+    return;
+  }
+  for (auto& span : spans) {
+    auto it = find_if(gpu_ms.begin(), gpu_ms.end(),
+                      [&](auto& entry) { return entry.first == span.name; });
+    if (it == gpu_ms.end()) {
+      gpu_ms.push_back({span.name, {}});
+      it = gpu_ms.end() - 1;
+    }
+    it->second.push_back(span.ms);
+  }
+}
+
+double Benchmark::throughput() const {
+  double seconds = milliseconds(last_frame_end - recording_started) / 1000.0;
+  return seconds > 0 ? cpu_ms.size() / seconds : 0.0;
+}
+
+void Benchmark::print() const {
+  auto line = [](const string& name, const SampleSummary& s) {
+    println(
+        "  {:<20} mean {:8.3f}  p50 {:8.3f}  p95 {:8.3f}  p99 {:8.3f}  "
+        "max {:8.3f} ms",
+        name, s.mean, s.p50, s.p95, s.p99, s.max);
+  };
+  println("{} frames after {} warmup on {}, {:.1f} frames/s", cpu_ms.size(),
+          warmup_frames, device_name, throughput());
+  println("  {}, {} frames in flight{}", present_mode, frames_in_flight,
+          present_wait ? ", present wait" : "");
+  println("  {} draws ({} instances), {}", draws, instances,
+          indirect_draws ? "indirect" : "direct");
+  line("cpu frame time", SampleSummary::of(cpu_ms));
+  line("frame interval", SampleSummary::of(interval_ms));
+  line("input to submit", SampleSummary::of(input_ms));
+  line("submit to complete", SampleSummary::of(submit_latency.latency_ms));
+  for (auto& [name, samples] : gpu_ms) {
+    line("gpu " + name, SampleSummary::of(samples));
+  }
+}
+
+string Benchmark::to_json(VkExtent2D extent, bool headless) const {
+  string gpu_json;
+  for (auto& [name, samples] : gpu_ms) {
+    gpu_json += fmt::format("{}\n    \"{}\": {}", gpu_json.empty() ? "" : ",",
+                            name, SampleSummary::of(samples).to_json());
+  }
+  return fmt::format(
+      "{{\n  \"device\": \"{}\",\n  \"width\": {},\n  \"height\": {},\n"
+      "  \"headless\": {},\n  \"present_mode\": \"{}\",\n"
+      "  \"frames_in_flight\": {},\n  \"present_wait\": {},\n"
+      "  \"draws\": {},\n  \"instances\": {},\n"
+      "  \"indirect_draws\": {},\n"
+      "  \"warmup_frames\": {},\n  \"frames\": {},\n"
+      "  \"frames_per_second\": {:.4f},\n  \"cpu_frame_ms\": {},\n"
+      "  \"frame_interval_ms\": {},\n  \"input_to_submit_ms\": {},\n"
+      "  \"submit_to_complete_ms\": {},\n  \"gpu_ms\": {{{}\n  }}\n}}\n",
+      device_name, extent.width, extent.height, headless, present_mode,
+      frames_in_flight, present_wait, draws, instances, indirect_draws,
+      warmup_frames, cpu_ms.size(), throughput(),
+      SampleSummary::of(cpu_ms).to_json(),
+      SampleSummary::of(interval_ms).to_json(),
+      SampleSummary::of(input_ms).to_json(),
+      SampleSummary::of(submit_latency.latency_ms).to_json(), gpu_json);
+}
+
+void Benchmark::write_json(const path& file,
+                           VkExtent2D extent,
+                           bool headless) const {
+  if (file.has_parent_path()) {
+    create_directories(file.parent_path());
+  }
+  ofstream out(file, ios::trunc);
+  if (!out) {
+    println("unable to write benchmark results to {}", file.string());
+    return;
+  }
+  out << to_json(extent, headless);
+  println("wrote benchmark results to {}", file.string());
+}
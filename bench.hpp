@@ -0,0 +1,104 @@
+#pragma once
+
+#include "gpu_timer.hpp"
+#include "lib.hpp"
+
+// mean and nearest rank percentiles of one metric, in milliseconds
+struct SampleSummary {
+  size_t count = 0;
+  double mean = 0;
+  double p50 = 0;
+  double p95 = 0;
+  double p99 = 0;
+  double max = 0;
+
+  static SampleSummary of(vector<double> samples);
+  string to_json() const;
+};
+
+// time from vkQueueSubmit until the frame's timeline value is reached,
+// without making the frame loop wait for it: a thread waits on every
+// submitted value in order and timestamps it as soon as the wait returns
+struct SubmitLatencyProbe {
+  struct Submission {
+    u64 timeline_value;
+    chrono::steady_clock::time_point submitted_at;
+    // warmup submissions are waited on but not sampled
+    bool record;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  VkSemaphore timeline = VK_NULL_HANDLE;
+  thread waiter;
+  mutex submissions_mutex;
+  condition_variable submissions_changed;
+  deque<Submission> pending;
+  u64 submitted_count = 0;
+  u64 observed_count = 0;
+  vector<double> latency_ms;
+  bool stopping = false;
+
+  void start(VkDevice device, VkSemaphore timeline);
+  void stop();
+  // right after vkQueueSubmit2, `submitted_at` taken right before it
+  void submitted(u64 timeline_value,
+                 chrono::steady_clock::time_point submitted_at,
+                 bool record);
+  // every submission so far has been observed
+  void wait_for_all();
+
+ private:
+  void work();
+};
+
+// --bench: per frame cpu time, frame interval and submit to completion
+// latency
+// after a warmup, summarized at the end
+struct Benchmark {
+  u64 warmup_frames = 0;
+  u64 frames = 0;
+  string device_name;
+  // the latency mode being measured, reported alongside the numbers
+  string present_mode;
+  u32 frames_in_flight = 0;
+  bool present_wait = false;
+  // and the draw submission being measured
+  u64 draws = 0;
+  u64 instances = 0;
+  bool indirect_draws = false;
+  u64 frames_seen = 0;
+  // past the warmup
+  bool recording = false;
+  // time spent in render_frame
+  vector<double> cpu_ms;
+  // start to start of consecutive frames
+  vector<double> interval_ms;
+  // input polled until the frame using it was submitted
+  vector<double> input_ms;
+  // per gpu timer span, in the order they were first seen
+  vector<pair<string, vector<double>>> gpu_ms;
+  chrono::steady_clock::time_point recording_started;
+  chrono::steady_clock::time_point previous_frame_start;
+  chrono::steady_clock::time_point last_frame_end;
+  SubmitLatencyProbe submit_latency;
+
+  void start(VkDevice device,
+             VkSemaphore timeline,
+             const string& device_name,
+             u64 warmup_frames,
+             u64 frames);
+  void stop();
+  // after every render_frame
+  void frame(chrono::steady_clock::time_point start,
+             chrono::steady_clock::time_point end);
+  // right after a frame's submit, ignored during the warmup
+  void input_latency(chrono::steady_clock::time_point input_sampled_at,
+                     chrono::steady_clock::time_point submitted_at);
+  // a frame's resolved gpu timer spans, ignored during the warmup
+  void gpu_times(const vector<GpuSpan>& spans);
+  // recorded frames per second of wall time
+  double throughput() const;
+  void print() const;
+  string to_json(VkExtent2D extent, bool headless) const;
+  void write_json(const path& file, VkExtent2D extent, bool headless) const;
+};
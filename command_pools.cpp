@@ -0,0 +1,108 @@
+#include "command_pools.hpp"
+
+#include "host_allocator.hpp"
+
+void FrameCommandPools::init(VkDevice device,
+                             u32 queue_family_index,
+                             Timeline* timeline,
+                             u32 frame_count,
+                             u32 lane_count) {
+  this->device = device;
+  this->timeline = timeline;
+  frames.resize(frame_count);
+  for (auto& frame : frames) {
+    frame.lanes.resize(lane_count);
+    for (auto& lane : frame.lanes) {
+      VkCommandPoolCreateInfo pool_info = {
+          .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+          // no RESET_COMMAND_BUFFER_BIT, buffers are only reset with the pool
+          .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+          .queueFamilyIndex = queue_family_index,
+      };
+      VK_CHECK(vkCreateCommandPool(device, &pool_info,
+                                   vk_allocator(VK_OBJECT_TYPE_COMMAND_POOL),
+                                   &lane.pool),
+               "unable to create frame command pool");
+    }
+  }
+}
+
+void FrameCommandPools::destroy() {
+  for (auto& frame : frames) {
+    // frees the command buffers as well
+    for (auto& lane : frame.lanes) {
+      vkDestroyCommandPool(device, lane.pool,
+                           vk_allocator(VK_OBJECT_TYPE_COMMAND_POOL));
+    }
+  }
+  frames.clear();
+}
+
+u32 FrameCommandPools::lane_count() const {
+  return frames.empty() ? 0 : static_cast<u32>(frames[0].lanes.size());
+}
+
+void FrameCommandPools::begin_frame(u32 frame) {
+  current = frame;
+  Frame& f = frames[frame];
+  // uploads made during init come from frame 0 without a frame to wait on
+  timeline->wait(f.timeline_value);
+
+  u32 handed_out = 0;
+  for (auto& lane : f.lanes) {
+    if (lane.next_primary + lane.next_secondary == 0) {
+      continue;
+    }
+    handed_out += lane.next_primary + lane.next_secondary;
+    vkResetCommandPool(device, lane.pool, 0);
+    lane.next_primary = 0;
+    lane.next_secondary = 0;
+    resets++;
+  }
+  frame_command_buffers = handed_out;
+  peak_frame_command_buffers = max(peak_frame_command_buffers, handed_out);
+}
+
+VkCommandBuffer FrameCommandPools::allocate(VkCommandBufferLevel level,
+                                            u32 lane) {
+  Lane& l = frames[current].lanes[lane];
+  bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  vector<VkCommandBuffer>& command_buffers =
+      primary ? l.primaries : l.secondaries;
+  u32& next = primary ? l.next_primary : l.next_secondary;
+
+  if (next == command_buffers.size()) {
+    VkCommandBufferAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = l.pool,
+        .level = level,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer command_buffer;
+    VK_CHECK(
+        vkAllocateCommandBuffers(device, &allocate_info, &command_buffer),
+        "unable to allocate command buffer");
+    command_buffers.push_back(command_buffer);
+    allocations++;
+  }
+  return command_buffers[next++];
+}
+
+void FrameCommandPools::submitted(u64 timeline_value) {
+  frames[current].timeline_value =
+      max(frames[current].timeline_value, timeline_value);
+}
+
+void FrameCommandPools::print_stats() const {
+  println(
+      "command pools: {} frames x {} lanes, {} resets, {} command buffers "
+      "allocated, {} used by the last frame (peak {})",
+      frames.size(), lane_count(), resets, allocations.load(),
+      frame_command_buffers, peak_frame_command_buffers);
+  const HostAllocationCounters* counters =
+      host_allocator.object_counters(VK_OBJECT_TYPE_COMMAND_POOL);
+  if (counters != nullptr) {
+    println("  driver memory behind them: {} B live, {} B peak",
+            counters->live_bytes.load(), counters->peak_bytes.load());
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "lib.hpp"
+#include "timeline.hpp"
+
+// per frame in flight, one transient command pool per recording lane (lane 0
+// is the main thread, the others belong to parallel recording chunks).
+// command buffers are handed out on demand and never reset or freed one by
+// one: all of a frame's pools are reset with vkResetCommandPool once
+// everything submitted from them has finished. that is the fast path drivers
+// recommend, and it keeps pool memory at what the busiest frame needed.
+struct FrameCommandPools {
+  struct Lane {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    // allocated so far, handed out again in order after every reset
+    vector<VkCommandBuffer> primaries;
+    vector<VkCommandBuffer> secondaries;
+    u32 next_primary = 0;
+    u32 next_secondary = 0;
+  };
+
+  struct Frame {
+    vector<Lane> lanes;
+    // the last submission that used any of its command buffers
+    u64 timeline_value = 0;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  Timeline* timeline = nullptr;
+  vector<Frame> frames;
+  // the frame command buffers are allocated from, frame 0 during init
+  u32 current = 0;
+
+  // pool resets so far
+  u64 resets = 0;
+  // vkAllocateCommandBuffers calls. levels off once every lane has seen
+  // its busiest frame
+  atomic<u64> allocations = 0;
+  // command buffers handed out by the last finished frame, and by the most
+  // demanding one
+  u32 frame_command_buffers = 0;
+  u32 peak_frame_command_buffers = 0;
+
+  void init(VkDevice device,
+            u32 queue_family_index,
+            Timeline* timeline,
+            u32 frame_count,
+            u32 lane_count);
+  void destroy();
+  u32 lane_count() const;
+
+  // makes `frame` current. waits for whatever was last submitted from its
+  // pools (normally done already) and resets them
+  void begin_frame(u32 frame);
+  // from the current frame's pool for `lane`. a lane must only be used by
+  // one thread at a time
+  VkCommandBuffer allocate(VkCommandBufferLevel level, u32 lane = 0);
+  // after submitting command buffers allocated from the current frame
+  void submitted(u64 timeline_value);
+
+  void print_stats() const;
+};
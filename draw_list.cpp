@@ -0,0 +1,129 @@
+#include "draw_list.hpp"
+
+#include "trace.hpp"
+
+void DrawList::init(VkDevice device,
+                    VmaAllocator allocator,
+                    UploadManager* uploads,
+                    DeletionQueue* deletion_queue) {
+  this->device = device;
+  this->allocator = allocator;
+  this->uploads = uploads;
+  this->deletion_queue = deletion_queue;
+}
+
+void DrawList::destroy() {
+  destroy_buffer(draw_data);
+  destroy_buffer(commands);
+  destroy_buffer(instances);
+}
+
+void DrawList::build(const vector<Draw>& draws,
+                     const vector<InstanceData>& instances,
+                     u64 last_used_value) {
+  TRACE_SCOPE("build draw list", "{} draws", draws.size());
+  vector<DrawData> data;
+  vector<VkDrawIndirectCommand> draw_commands;
+  data.reserve(draws.size());
+  draw_commands.reserve(draws.size());
+  batches.clear();
+  for (u32 i = 0; i < draws.size(); i++) {
+    const Draw& draw = draws[i];
+    data.push_back(draw.data);
+    draw_commands.push_back({
+        .vertexCount = draw.vertex_count,
+        .instanceCount = draw.instance_count,
+        .firstVertex = draw.first_vertex,
+        .firstInstance = draw.first_instance,
+    });
+    if (batches.empty() || batches.back().pipeline != draw.pipeline ||
+        batches.back().state != draw.state) {
+      batches.push_back(
+          {.pipeline = draw.pipeline, .state = draw.state, .first_draw = i});
+    }
+    batches.back().draw_count++;
+  }
+  counts.clear();
+  for (auto& batch : batches) {
+    counts.push_back(batch.draw_count);
+  }
+  draw_count = static_cast<u32>(draws.size());
+  instance_count = static_cast<u32>(instances.size());
+
+  // frames in flight may still read the current buffers, writing new ones
+  // avoids having to order the copies after them
+  if (draw_data.buffer != VK_NULL_HANDLE) {
+    Buffer old_buffers[] = {draw_data, commands, this->instances};
+    deletion_queue->defer(last_used_value, [this, old_buffers]() mutable {
+      for (auto& buffer : old_buffers) {
+        destroy_buffer(buffer);
+      }
+    });
+  }
+
+  draw_data = create_buffer(data.data(), sizeof(DrawData) * data.size(),
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  VkBufferDeviceAddressInfo address_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .buffer = draw_data.buffer,
+  };
+  draw_data_address = vkGetBufferDeviceAddress(device, &address_info);
+  commands = create_buffer(draw_commands.data(),
+                           sizeof(VkDrawIndirectCommand) * draw_commands.size(),
+                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+  this->instances = create_buffer(instances.data(),
+                                  sizeof(InstanceData) * instances.size(),
+                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+}
+
+FrameAllocation DrawList::write_counts(FrameAllocator& frame_allocator) const {
+  if (counts.empty()) {
+    return {};
+  }
+  return frame_allocator.push(counts.data(), counts.size());
+}
+
+void DrawList::draw(VkCommandBuffer command_buffer,
+                    size_t batch,
+                    const FrameAllocation& frame_counts) const {
+  const Batch& b = batches[batch];
+  // the count is read on the gpu, so lowering it (culling, say) doesn't
+  // change the command buffer. `draw_count` is only the upper bound
+  vkCmdDrawIndirectCount(
+      command_buffer, commands.buffer,
+      sizeof(VkDrawIndirectCommand) * b.first_draw, frame_counts.buffer,
+      frame_counts.offset + sizeof(u32) * batch, b.draw_count,
+      sizeof(VkDrawIndirectCommand));
+}
+
+DrawList::Buffer DrawList::create_buffer(const void* data,
+                                         VkDeviceSize size,
+                                         VkBufferUsageFlags usage) {
+  Buffer buffer;
+  VkBufferCreateInfo buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      // an empty draw list still gets valid buffers
+      .size = max<VkDeviceSize>(size, 16),
+      .usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  };
+  VmaAllocationCreateInfo alloc_info = {
+      // only ever written by the upload manager's copies
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+  };
+  VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &alloc_info,
+                           &buffer.buffer, &buffer.allocation, nullptr),
+           "unable to create draw list buffer");
+  if (size > 0) {
+    // submitted with the next flush, ahead of the frame that draws with it
+    uploads->upload_buffer(buffer.buffer, 0, data, size);
+  }
+  return buffer;
+}
+
+void DrawList::destroy_buffer(Buffer& buffer) {
+  if (buffer.buffer != VK_NULL_HANDLE) {
+    vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+    buffer = {};
+  }
+}
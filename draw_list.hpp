@@ -0,0 +1,73 @@
+#pragma once
+
+#include "draw_state.hpp"
+#include "frame_allocator.hpp"
+#include "lib.hpp"
+#include "upload.hpp"
+
+// the draw list as the gpu sees it. per draw data (read by the vertex shader
+// through a buffer device address) and indirect draw commands are packed
+// into device-local buffers whenever the draws change, and consecutive
+// draws with the same pipeline and state form a batch that takes a single
+// vkCmdDrawIndirectCount. the batch draw counts are written into every
+// frame's frame allocator slice, so they can change from frame to frame
+// without rebuilding or re-recording anything. recording a frame costs one
+// draw call per batch, however many draws there are. instanced draws take
+// their per instance attributes from one shared instance buffer.
+struct DrawList {
+  struct Batch {
+    PipelineHandle pipeline = 0;
+    DrawState state;
+    u32 first_draw = 0;
+    u32 draw_count = 0;
+  };
+
+  struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  VmaAllocator allocator = VK_NULL_HANDLE;
+  UploadManager* uploads = nullptr;
+  DeletionQueue* deletion_queue = nullptr;
+
+  // DrawData per draw
+  Buffer draw_data;
+  VkDeviceAddress draw_data_address = 0;
+  // VkDrawIndirectCommand per draw
+  Buffer commands;
+  // draw count per batch, copied to the gpu by `write_counts` every frame
+  vector<u32> counts;
+  // InstanceData, bound as vertex buffer binding 1
+  Buffer instances;
+  vector<Batch> batches;
+  u32 draw_count = 0;
+  u32 instance_count = 0;
+
+  void init(VkDevice device,
+            VmaAllocator allocator,
+            UploadManager* uploads,
+            DeletionQueue* deletion_queue);
+  void destroy();
+
+  // packs `draws` and the `instances` they refer to into new buffers,
+  // uploaded with the next flush. the current ones are destroyed once the
+  // gpu reaches `last_used_value`, so frames in flight keep drawing from them
+  void build(const vector<Draw>& draws,
+             const vector<InstanceData>& instances,
+             u64 last_used_value);
+  // this frame's copy of `counts`, for `draw` to read the draw counts from
+  FrameAllocation write_counts(FrameAllocator& frame_allocator) const;
+  // every draw of `batch`. its pipeline, state and push constants (with
+  // `first_draw` of the batch) have to be set already
+  void draw(VkCommandBuffer command_buffer,
+            size_t batch,
+            const FrameAllocation& frame_counts) const;
+
+ private:
+  Buffer create_buffer(const void* data,
+                       VkDeviceSize size,
+                       VkBufferUsageFlags usage);
+  void destroy_buffer(Buffer& buffer);
+};
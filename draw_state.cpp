@@ -0,0 +1,45 @@
+#include "draw_state.hpp"
+
+void DrawState::bake(PipelineKey& key) const {
+  key.cull_mode = static_cast<uint8_t>(cull_mode);
+  key.front_face = static_cast<uint8_t>(front_face);
+  key.topology = static_cast<uint8_t>(topology);
+  key.depth_test = depth_test ? VK_TRUE : VK_FALSE;
+  key.depth_write = depth_write ? VK_TRUE : VK_FALSE;
+  key.depth_compare = static_cast<uint8_t>(depth_compare);
+}
+
+void DrawStateCache::bind_pipeline(VkCommandBuffer command_buffer,
+                                   VkPipeline pipeline) {
+  if (pipeline == bound_pipeline) {
+    return;
+  }
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+  bound_pipeline = pipeline;
+}
+
+void DrawStateCache::set(VkCommandBuffer command_buffer,
+                         const DrawState& state) {
+  // dynamic state survives pipeline binds as long as the new pipeline also
+  // declares it dynamic, which every pipeline in this mode does
+  if (!valid || state.cull_mode != current.cull_mode) {
+    vkCmdSetCullMode(command_buffer, state.cull_mode);
+  }
+  if (!valid || state.front_face != current.front_face) {
+    vkCmdSetFrontFace(command_buffer, state.front_face);
+  }
+  if (!valid || state.topology != current.topology) {
+    vkCmdSetPrimitiveTopology(command_buffer, state.topology);
+  }
+  if (!valid || state.depth_test != current.depth_test) {
+    vkCmdSetDepthTestEnable(command_buffer, state.depth_test);
+  }
+  if (!valid || state.depth_write != current.depth_write) {
+    vkCmdSetDepthWriteEnable(command_buffer, state.depth_write);
+  }
+  if (!valid || state.depth_compare != current.depth_compare) {
+    vkCmdSetDepthCompareOp(command_buffer, state.depth_compare);
+  }
+  current = state;
+  valid = true;
+}
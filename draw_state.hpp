@@ -0,0 +1,52 @@
+#pragma once
+
+#include "lib.hpp"
+#include "pipeline.hpp"
+#include "pipeline_registry.hpp"
+
+// the fixed function state a draw wants. baked into its pipeline when
+// extended dynamic state is off, set while recording when it's on
+struct DrawState {
+  VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  bool depth_test = true;
+  bool depth_write = true;
+  VkCompareOp depth_compare = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+  // writes the fields above into `key`
+  void bake(PipelineKey& key) const;
+  bool operator==(const DrawState& other) const = default;
+};
+
+// what the vertex shader reads for a draw, matches `DrawData` in main.vert
+struct DrawData {
+  // added to every vertex position
+  glm::vec4 offset = glm::vec4(0.f);
+  // multiplies every vertex color
+  glm::vec4 tint = glm::vec4(1.f);
+};
+
+struct Draw {
+  PipelineHandle pipeline = 0;
+  DrawState state;
+  u32 vertex_count = 0;
+  u32 first_vertex = 0;
+  // instanced pipelines read instances [first_instance, first_instance +
+  // instance_count) of the draw list's instance buffer
+  u32 instance_count = 1;
+  u32 first_instance = 0;
+  DrawData data;
+};
+
+// remembers what was last set on a command buffer, so consecutive draws
+// only pay for the state that actually changes. use a new one for every
+// command buffer
+struct DrawStateCache {
+  bool valid = false;
+  DrawState current;
+  VkPipeline bound_pipeline = VK_NULL_HANDLE;
+
+  void bind_pipeline(VkCommandBuffer command_buffer, VkPipeline pipeline);
+  void set(VkCommandBuffer command_buffer, const DrawState& state);
+};
@@ -0,0 +1,18 @@
+#include "embedded_shaders.hpp"
+
+#ifdef EMBED_SHADERS
+// generated by CMake, defines the `embedded_shaders` table as constexpr
+// arrays filled in by glslc
+#include "embedded_shaders.inc"
+#endif
+
+optional<EmbeddedShader> find_embedded_shader(const string& name) {
+#ifdef EMBED_SHADERS
+  for (auto& shader : embedded_shaders) {
+    if (name == shader.name) {
+      return shader;
+    }
+  }
+#endif
+  return {};
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "lib.hpp"
+
+// spirv compiled from shaders/ at build time, see CMakeLists.txt
+struct EmbeddedShader {
+  const char* name;
+  const u32* words;
+  size_t word_count;
+};
+
+optional<EmbeddedShader> find_embedded_shader(const string& name);
@@ -0,0 +1,93 @@
+#include "frame_allocator.hpp"
+
+#include <algorithm>
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void FrameAllocator::init(VkDevice device,
+                          VmaAllocator allocator,
+                          const VkPhysicalDeviceLimits& limits,
+                          u32 frame_count,
+                          VkDeviceSize slice_size) {
+  this->allocator = allocator;
+  // all of these are powers of two, so the largest is a multiple of the rest
+  min_alignment = max({min_alignment, limits.minUniformBufferOffsetAlignment,
+                       limits.minStorageBufferOffsetAlignment,
+                       limits.nonCoherentAtomSize});
+  slice_size = align_up(slice_size, min_alignment);
+
+  VkBufferCreateInfo buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = slice_size * frame_count,
+      .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+               VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+               VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+  };
+  VmaAllocationCreateInfo alloc_info = {
+      // ends up in device-local host-visible memory (rebar) when there is
+      // some, the gpu reads every byte exactly once either way
+      .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+               VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+  };
+  VmaAllocationInfo allocation_info;
+  VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &alloc_info, &buffer,
+                           &allocation, &allocation_info),
+           "unable to create frame allocator buffer");
+  data = static_cast<char*>(allocation_info.pMappedData);
+
+  VkBufferDeviceAddressInfo address_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+      .buffer = buffer,
+  };
+  address = vkGetBufferDeviceAddress(device, &address_info);
+
+  slices.resize(frame_count);
+  for (u32 i = 0; i < frame_count; i++) {
+    slices[i] = {.begin = slice_size * i,
+                 .end = slice_size * (i + 1),
+                 .head = slice_size * i};
+  }
+}
+
+void FrameAllocator::destroy() {
+  vmaDestroyBuffer(allocator, buffer, allocation);
+}
+
+void FrameAllocator::begin_frame(u32 frame) {
+  current = frame;
+  slices[current].head = slices[current].begin;
+}
+
+FrameAllocation FrameAllocator::allocate(VkDeviceSize size,
+                                         VkDeviceSize alignment) {
+  Slice& slice = slices[current];
+  VkDeviceSize offset = align_up(slice.head, max(alignment, min_alignment));
+  if (offset + size > slice.end) {
+    throw runtime_error(fmt::format(
+        "frame allocator slice of {} bytes exhausted by a {} byte allocation",
+        slice.end - slice.begin, size));
+  }
+  slice.head = offset + size;
+  return {.buffer = buffer,
+          .offset = offset,
+          .size = size,
+          .data = data + offset,
+          .address = address + offset};
+}
+
+void FrameAllocator::flush_frame() {
+  Slice& slice = slices[current];
+  if (slice.head == slice.begin) {
+    return;
+  }
+  // no-op on host coherent memory
+  VK_CHECK(vmaFlushAllocation(allocator, allocation, slice.begin,
+                              slice.head - slice.begin),
+           "unable to flush frame allocator");
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "lib.hpp"
+
+// a piece of this frame's slice, valid until the frame slot comes around
+// again
+struct FrameAllocation {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // host pointer to write through
+  void* data = nullptr;
+  VkDeviceAddress address = 0;
+};
+
+// bump allocator for data that only lives for one frame (uniforms, dynamic
+// vertices, indirect arguments). one persistently mapped buffer is split
+// into a slice per frame in flight, and a slice is reset wholesale once the
+// previous frame that used it has finished, so allocating is a pointer bump
+// instead of a vma allocation per object.
+struct FrameAllocator {
+  struct Slice {
+    VkDeviceSize begin;
+    VkDeviceSize end;
+    VkDeviceSize head;
+  };
+
+  VmaAllocator allocator = VK_NULL_HANDLE;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  char* data = nullptr;
+  VkDeviceAddress address = 0;
+  // satisfies uniform, storage and non-coherent flush alignment at once
+  VkDeviceSize min_alignment = 16;
+  vector<Slice> slices;
+  u32 current = 0;
+
+  void init(VkDevice device,
+            VmaAllocator allocator,
+            const VkPhysicalDeviceLimits& limits,
+            u32 frame_count,
+            VkDeviceSize slice_size = 4 << 20);
+  void destroy();
+
+  // only call once the slot's previous frame finished on the gpu
+  void begin_frame(u32 frame);
+  // throws when the slice is exhausted
+  FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+  template <typename T>
+  FrameAllocation push(const T* values, size_t count) {
+    FrameAllocation a = allocate(sizeof(T) * count, alignof(T));
+    memcpy(a.data, values, sizeof(T) * count);
+    return a;
+  }
+  template <typename T>
+  FrameAllocation push(const T& value) {
+    return push(&value, 1);
+  }
+  // makes this frame's writes visible to the device, before submitting
+  void flush_frame();
+};
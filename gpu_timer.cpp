@@ -0,0 +1,128 @@
+#include "gpu_timer.hpp"
+
+#include "host_allocator.hpp"
+
+void GpuTimer::init(VkDevice device,
+                    const VkPhysicalDeviceLimits& limits,
+                    u32 timestamp_valid_bits,
+                    u32 frame_count) {
+  this->device = device;
+  frames.resize(frame_count);
+  enabled = timestamp_valid_bits > 0;
+  if (!enabled) {
+    println("timestamp queries aren't supported, gpu timing is off");
+    return;
+  }
+  period = limits.timestampPeriod;
+  valid_mask =
+      timestamp_valid_bits >= 64 ? ~0ull : (1ull << timestamp_valid_bits) - 1;
+
+  VkQueryPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+      .queryType = VK_QUERY_TYPE_TIMESTAMP,
+      .queryCount = frame_count * max_spans * 2,
+  };
+  VK_CHECK(vkCreateQueryPool(device, &pool_info,
+                             vk_allocator(VK_OBJECT_TYPE_QUERY_POOL), &pool),
+           "unable to create timestamp query pool");
+}
+
+void GpuTimer::destroy() {
+  if (pool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device, pool, vk_allocator(VK_OBJECT_TYPE_QUERY_POOL));
+    pool = VK_NULL_HANDLE;
+  }
+}
+
+bool GpuTimer::begin_frame(VkCommandBuffer command_buffer,
+                           u32 slot,
+                           u64 frame_number) {
+  if (!enabled) {
+    return false;
+  }
+  current_slot = slot;
+  bool resolved = resolve(slot);
+
+  Frame& frame = frames[slot];
+  frame.names.clear();
+  frame.frame_number = frame_number;
+  vkCmdResetQueryPool(command_buffer, pool, slot * max_spans * 2,
+                      max_spans * 2);
+  return resolved;
+}
+
+bool GpuTimer::replay_frame(u32 slot,
+                            u64 frame_number,
+                            const vector<const char*>& names) {
+  if (!enabled) {
+    return false;
+  }
+  current_slot = slot;
+  bool resolved = resolve(slot);
+
+  // the command buffer resets and writes the slot's queries itself
+  Frame& frame = frames[slot];
+  frame.names = names;
+  frame.frame_number = frame_number;
+  return resolved;
+}
+
+bool GpuTimer::resolve(u32 slot) {
+  Frame& frame = frames[slot];
+  u32 first_query = slot * max_spans * 2;
+
+  bool resolved = false;
+  if (!frame.names.empty()) {
+    u32 query_count = static_cast<u32>(frame.names.size()) * 2;
+    vector<u64> ticks(query_count);
+    // no wait flag, a frame that somehow isn't done yet is simply skipped
+    VkResult result = vkGetQueryPoolResults(
+        device, pool, first_query, query_count, ticks.size() * sizeof(u64),
+        ticks.data(), sizeof(u64), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+      results.clear();
+      for (size_t i = 0; i < frame.names.size(); i++) {
+        u64 elapsed = (ticks[i * 2 + 1] - ticks[i * 2]) & valid_mask;
+        results.push_back({.name = frame.names[i],
+                           .ms = static_cast<double>(elapsed) * period / 1e6});
+      }
+      results_frame_number = frame.frame_number;
+      resolved = true;
+    }
+  }
+  return resolved;
+}
+
+u32 GpuTimer::begin(VkCommandBuffer command_buffer, const char* name) {
+  Frame& frame = frames[current_slot];
+  if (!enabled || frame.names.size() == max_spans) {
+    return max_spans;
+  }
+  u32 span = static_cast<u32>(frame.names.size());
+  frame.names.push_back(name);
+  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
+                       pool, (current_slot * max_spans + span) * 2);
+  return span;
+}
+
+void GpuTimer::end(VkCommandBuffer command_buffer, u32 span) {
+  if (span == max_spans) {
+    return;
+  }
+  // after everything recorded before it has finished
+  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT,
+                       pool, (current_slot * max_spans + span) * 2 + 1);
+}
+
+void GpuTimer::print() const {
+  if (results.empty()) {
+    println("no gpu timings yet");
+    return;
+  }
+  string line = fmt::format("gpu times, frame {}:", results_frame_number);
+  for (auto& span : results) {
+    line += fmt::format(" {} {:.3f} ms,", span.name, span.ms);
+  }
+  line.pop_back();
+  println("{}", line);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "lib.hpp"
+
+struct GpuSpan {
+  const char* name;
+  double ms;
+};
+
+// named gpu time spans (passes, draw groups) from timestamp queries. every
+// frame in flight has its own slice of the query pool, which is read back
+// without waiting the next time that frame slot comes around, once its
+// timeline value has been reached
+struct GpuTimer {
+  struct Frame {
+    // span i is written to queries 2i (start) and 2i+1 (end)
+    vector<const char*> names;
+    u64 frame_number = 0;
+  };
+
+  static constexpr u32 max_spans = 32;
+
+  VkDevice device = VK_NULL_HANDLE;
+  VkQueryPool pool = VK_NULL_HANDLE;
+  // the queue family doesn't support timestamps
+  bool enabled = false;
+  // nanoseconds per tick
+  double period = 1;
+  u64 valid_mask = ~0ull;
+  vector<Frame> frames;
+  u32 current_slot = 0;
+  // the latest frame that was read back
+  vector<GpuSpan> results;
+  u64 results_frame_number = 0;
+
+  void init(VkDevice device,
+            const VkPhysicalDeviceLimits& limits,
+            u32 timestamp_valid_bits,
+            u32 frame_count);
+  void destroy();
+  // right after vkBeginCommandBuffer, once the slot's last frame finished.
+  // returns whether `results` now holds the slot's previous frame
+  bool begin_frame(VkCommandBuffer command_buffer,
+                   u32 slot,
+                   u64 frame_number);
+  // instead of `begin_frame` when the slot submits a command buffer recorded
+  // earlier, whose spans were `names`
+  bool replay_frame(u32 slot,
+                    u64 frame_number,
+                    const vector<const char*>& names);
+  // returns the span to pass to `end`
+  u32 begin(VkCommandBuffer command_buffer, const char* name);
+  void end(VkCommandBuffer command_buffer, u32 span);
+  void print() const;
+
+ private:
+  // reads back the slot's previous frame into `results`
+  bool resolve(u32 slot);
+};
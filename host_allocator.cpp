@@ -0,0 +1,246 @@
+#include "host_allocator.hpp"
+
+#include <algorithm>
+
+HostAllocator host_allocator;
+
+namespace {
+
+// stored right in front of every pointer handed to the driver
+struct AllocationHeader {
+  void* base;
+  size_t size;
+  size_t alignment;
+  HostAllocator::Tag* tag;
+  u32 scope;
+  bool from_arena;
+};
+
+size_t align_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+AllocationHeader* header_of(void* memory) {
+  return reinterpret_cast<AllocationHeader*>(static_cast<char*>(memory) -
+                                             sizeof(AllocationHeader));
+}
+
+// room for the header plus worst case alignment padding
+size_t padded_size(size_t size, size_t alignment) {
+  return size + sizeof(AllocationHeader) + alignment;
+}
+
+void* VKAPI_PTR allocate(void* user_data,
+                         size_t size,
+                         size_t alignment,
+                         VkSystemAllocationScope scope) {
+  auto* tag = static_cast<HostAllocator::Tag*>(user_data);
+  HostAllocator& allocator = *tag->allocator;
+  alignment = max(alignment, alignof(AllocationHeader));
+  size_t total = padded_size(size, alignment);
+
+  char* base = nullptr;
+  bool from_arena = false;
+  if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND &&
+      !allocator.arena.empty() &&
+      this_thread::get_id() == allocator.arena_thread) {
+    if (allocator.arena_head + total <= allocator.arena.size()) {
+      base = allocator.arena.data() + allocator.arena_head;
+      allocator.arena_head += total;
+      from_arena = true;
+      allocator.arena_allocations++;
+    } else {
+      allocator.arena_overflows++;
+    }
+  }
+  if (base == nullptr) {
+    base = static_cast<char*>(malloc(total));
+    if (base == nullptr) {
+      return nullptr;
+    }
+  }
+
+  char* memory = reinterpret_cast<char*>(
+      align_up(reinterpret_cast<uintptr_t>(base + sizeof(AllocationHeader)),
+               alignment));
+  *header_of(memory) = {.base = base,
+                        .size = size,
+                        .alignment = alignment,
+                        .tag = tag,
+                        .scope = static_cast<u32>(scope),
+                        .from_arena = from_arena};
+  tag->counters.add(size);
+  allocator.scopes[scope].add(size);
+  return memory;
+}
+
+void VKAPI_PTR free_memory(void* user_data, void* memory) {
+  if (memory == nullptr) {
+    return;
+  }
+  AllocationHeader header = *header_of(memory);
+  header.tag->counters.remove(header.size);
+  header.tag->allocator->scopes[header.scope].remove(header.size);
+  // arena memory is reclaimed wholesale at the next frame
+  if (!header.from_arena) {
+    free(header.base);
+  }
+}
+
+void* VKAPI_PTR reallocate(void* user_data,
+                           void* original,
+                           size_t size,
+                           size_t alignment,
+                           VkSystemAllocationScope scope) {
+  if (original == nullptr) {
+    return allocate(user_data, size, alignment, scope);
+  }
+  if (size == 0) {
+    free_memory(user_data, original);
+    return nullptr;
+  }
+  void* memory = allocate(user_data, size, alignment, scope);
+  if (memory == nullptr) {
+    // the original stays valid, as the spec requires
+    return nullptr;
+  }
+  memcpy(memory, original, min(size, header_of(original)->size));
+  free_memory(user_data, original);
+  return memory;
+}
+
+void VKAPI_PTR internal_allocation(void* user_data,
+                                   size_t size,
+                                   VkInternalAllocationType type,
+                                   VkSystemAllocationScope scope) {
+  static_cast<HostAllocator::Tag*>(user_data)->allocator->internal.add(size);
+}
+
+void VKAPI_PTR internal_free(void* user_data,
+                             size_t size,
+                             VkInternalAllocationType type,
+                             VkSystemAllocationScope scope) {
+  static_cast<HostAllocator::Tag*>(user_data)->allocator->internal.remove(
+      size);
+}
+
+}  // namespace
+
+void HostAllocationCounters::add(size_t size) {
+  u64 live = live_bytes += size;
+  live_count++;
+  total_count++;
+  u64 peak = peak_bytes;
+  while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+  }
+}
+
+void HostAllocationCounters::remove(size_t size) {
+  live_bytes -= size;
+  live_count--;
+}
+
+void HostAllocator::init(bool enabled, size_t command_arena_size) {
+  this->enabled = enabled;
+  if (enabled && command_arena_size > 0) {
+    arena.resize(command_arena_size);
+    arena_thread = this_thread::get_id();
+  }
+}
+
+const VkAllocationCallbacks* HostAllocator::callbacks(
+    VkObjectType object_type) {
+  if (!enabled) {
+    return nullptr;
+  }
+  lock_guard lock(tags_mutex);
+  unique_ptr<Tag>& tag = tags[static_cast<u32>(object_type)];
+  if (!tag) {
+    tag = make_unique<Tag>();
+    tag->allocator = this;
+    tag->object_type = object_type;
+    tag->callbacks = {
+        .pUserData = tag.get(),
+        .pfnAllocation = allocate,
+        .pfnReallocation = reallocate,
+        .pfnFree = free_memory,
+        .pfnInternalAllocation = internal_allocation,
+        .pfnInternalFree = internal_free,
+    };
+  }
+  return &tag->callbacks;
+}
+
+const HostAllocationCounters* HostAllocator::object_counters(
+    VkObjectType object_type) {
+  if (!enabled) {
+    return nullptr;
+  }
+  lock_guard lock(tags_mutex);
+  auto it = tags.find(static_cast<u32>(object_type));
+  return it == tags.end() ? nullptr : &it->second->counters;
+}
+
+void HostAllocator::begin_frame() {
+  if (!enabled) {
+    return;
+  }
+  // command scope allocations never outlive the call that made them
+  arena_head = 0;
+  if (frames == 0) {
+    total_at_first_frame = total_allocations();
+  }
+  frames++;
+}
+
+u64 HostAllocator::total_allocations() const {
+  u64 total = 0;
+  for (auto& scope : scopes) {
+    total += scope.total_count;
+  }
+  return total;
+}
+
+void HostAllocator::print_report() {
+  if (!enabled) {
+    return;
+  }
+  println("host allocations by scope (live bytes/count, peak, total):");
+  for (u32 i = 0; i <= VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE; i++) {
+    auto& c = scopes[i];
+    println("  {:<40} {:>10} B {:>6} {:>10} B {:>8}",
+            string_VkSystemAllocationScope(
+                static_cast<VkSystemAllocationScope>(i)),
+            c.live_bytes.load(), c.live_count.load(), c.peak_bytes.load(),
+            c.total_count.load());
+  }
+
+  println("host allocations by object type:");
+  lock_guard lock(tags_mutex);
+  vector<Tag*> sorted;
+  for (auto& [type, tag] : tags) {
+    sorted.push_back(tag.get());
+  }
+  sort(sorted.begin(), sorted.end(), [](Tag* a, Tag* b) {
+    return a->counters.total_count > b->counters.total_count;
+  });
+  for (Tag* tag : sorted) {
+    auto& c = tag->counters;
+    println("  {:<40} {:>10} B {:>6} {:>10} B {:>8}",
+            string_VkObjectType(tag->object_type), c.live_bytes.load(),
+            c.live_count.load(), c.peak_bytes.load(), c.total_count.load());
+  }
+  println("  {:<40} {:>10} B {:>6} {:>10} B {:>8}", "driver internal",
+          internal.live_bytes.load(), internal.live_count.load(),
+          internal.peak_bytes.load(), internal.total_count.load());
+
+  if (frames > 0) {
+    u64 in_frames = total_allocations() - total_at_first_frame;
+    println("{} allocations over {} frames ({:.2f} per frame)", in_frames,
+            frames, static_cast<double>(in_frames) / frames);
+  }
+  if (!arena.empty()) {
+    println("command arena: {} allocations served, {} overflowed to the heap",
+            arena_allocations.load(), arena_overflows.load());
+  }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "lib.hpp"
+
+struct HostAllocationCounters {
+  atomic<u64> live_bytes = 0;
+  atomic<u64> live_count = 0;
+  atomic<u64> peak_bytes = 0;
+  // every allocation ever made, including freed ones
+  atomic<u64> total_count = 0;
+
+  void add(size_t size);
+  void remove(size_t size);
+};
+
+// VkAllocationCallbacks that count driver host allocations per
+// VkSystemAllocationScope and per object type, so malloc traffic inside the
+// frame loop shows up. COMMAND scope allocations (which never outlive the
+// call that made them) can be served from a per-frame bump arena instead of
+// the heap.
+//
+// disabled, `callbacks` returns nullptr and the driver allocates as usual.
+// objects must be destroyed with the callbacks they were created with, so
+// this is decided once before the instance exists.
+struct HostAllocator {
+  // one set of callbacks per object type, `pUserData` points back here
+  struct Tag {
+    HostAllocator* allocator;
+    VkObjectType object_type;
+    VkAllocationCallbacks callbacks;
+    HostAllocationCounters counters;
+  };
+
+  bool enabled = false;
+  HostAllocationCounters scopes[VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1];
+  // pfnInternalAllocation, memory the driver got some other way
+  HostAllocationCounters internal;
+
+  mutex tags_mutex;
+  unordered_map<u32, unique_ptr<Tag>> tags;
+
+  // only the render thread allocates from the arena, it's reset between
+  // frames when none of its vulkan calls can be in progress
+  vector<char> arena;
+  size_t arena_head = 0;
+  thread::id arena_thread;
+  atomic<u64> arena_allocations = 0;
+  atomic<u64> arena_overflows = 0;
+
+  // marks for attributing allocations to the frame loop
+  u64 frames = 0;
+  u64 total_at_first_frame = 0;
+
+  void init(bool enabled, size_t command_arena_size);
+  const VkAllocationCallbacks* callbacks(VkObjectType object_type);
+  // nullptr unless enabled and something of that type was created
+  const HostAllocationCounters* object_counters(VkObjectType object_type);
+  // call on the render thread at the start of every frame
+  void begin_frame();
+  u64 total_allocations() const;
+  void print_report();
+};
+
+extern HostAllocator host_allocator;
+
+// what to pass as `pAllocator` to vkCreate*/vkDestroy*
+inline const VkAllocationCallbacks* vk_allocator(VkObjectType object_type) {
+  return host_allocator.callbacks(object_type);
+}
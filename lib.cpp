@@ -6,18 +6,33 @@ const char* os = "macos";
 const char* os = "windows";
 #endif
 
-void DeletionStack::init() {
+void DeletionQueue::init() {
   // shouldn't be more than this many vulkan objects at a time
   // apparently deque has less allocations and copies than vector,
   // but the implementation is really complicated
   cleanup_functions.reserve(20);
 }
 
-void DeletionStack::push(function<void()>&& fn) {
-  cleanup_functions.push_back(fn);
+void DeletionQueue::push(SmallFunction&& fn) {
+  cleanup_functions.push_back(std::move(fn));
 }
 
-void DeletionStack::flush() {
+void DeletionQueue::defer(u64 last_used_value, SmallFunction&& fn) {
+  deferred.push_back({last_used_value, std::move(fn)});
+}
+
+void DeletionQueue::collect(u64 completed) {
+  while (!deferred.empty() && deferred.front().last_used_value <= completed) {
+    deferred.front().fn();
+    deferred.pop_front();
+  }
+}
+
+void DeletionQueue::flush() {
+  for (auto& d : deferred) {
+    d.fn();
+  }
+  deferred.clear();
   for (auto it = cleanup_functions.rbegin(); it != cleanup_functions.rend();
        it++) {
     (*it)();
@@ -10,24 +10,33 @@
 #include <functional>
 #include <iostream>
 #include <optional>
-#include <shaderc/shaderc.hpp>
 #include <string>
 
 #include <vulkan/vk_enum_string_helper.h>
 #include <vulkan/vulkan_core.h>
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
+#include <cstddef>
 #include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #define GLFW_INCLUDE_VULKAN
@@ -38,11 +47,14 @@
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 
-// api for glsl -> spirv conversion
 #include <fmt/core.h>
 #include <fmt/ranges.h>
 
+// api for glsl -> spirv conversion, only needed when shaders aren't
+// (exclusively) compiled at build time
+#ifdef RUNTIME_SHADER_COMPILER
 #include <shaderc/shaderc.hpp>
+#endif
 
 #include <vma/vk_mem_alloc.h>
 
@@ -70,7 +82,8 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
-const u32 MAX_IN_FLIGHT_FRAMES = 2;
+// upper bound for --frames-in-flight, the default is 2
+const u32 MAX_IN_FLIGHT_FRAMES = 3;
 
 using namespace std;
 using namespace fmt;
@@ -78,16 +91,112 @@ using namespace filesystem;
 
 #define u32 uint32_t
 
-struct DeletionStack {
-  vector<function<void()>> cleanup_functions;
+// move-only void() callable that keeps small captures (a few handles) inline
+// instead of heap allocating like std::function. bigger callables still work,
+// they just end up on the heap
+class SmallFunction {
+ public:
+  static constexpr size_t capacity = 48;
+
+  SmallFunction() = default;
+  template <typename F,
+            typename = enable_if_t<!is_same_v<decay_t<F>, SmallFunction>>>
+  SmallFunction(F&& f) {
+    using Fn = decay_t<F>;
+    if constexpr (sizeof(Fn) <= capacity &&
+                  alignof(Fn) <= alignof(max_align_t) &&
+                  is_nothrow_move_constructible_v<Fn>) {
+      new (storage) Fn(std::forward<F>(f));
+      ops = &inline_ops<Fn>;
+    } else {
+      *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(f));
+      ops = &heap_ops<Fn>;
+    }
+  }
+  SmallFunction(SmallFunction&& other) noexcept { take(other); }
+  SmallFunction& operator=(SmallFunction&& other) noexcept {
+    if (this != &other) {
+      reset();
+      take(other);
+    }
+    return *this;
+  }
+  SmallFunction(const SmallFunction&) = delete;
+  SmallFunction& operator=(const SmallFunction&) = delete;
+  ~SmallFunction() { reset(); }
+
+  void operator()() { ops->call(storage); }
+  explicit operator bool() const { return ops != nullptr; }
+  void reset() {
+    if (ops != nullptr) {
+      ops->destroy(storage);
+      ops = nullptr;
+    }
+  }
+
+ private:
+  struct Ops {
+    void (*call)(void* storage);
+    // move constructs into `to` and destroys `from`
+    void (*relocate)(void* to, void* from);
+    void (*destroy)(void* storage);
+  };
+
+  template <typename Fn>
+  static constexpr Ops inline_ops = {
+      [](void* s) { (*static_cast<Fn*>(s))(); },
+      [](void* to, void* from) {
+        new (to) Fn(std::move(*static_cast<Fn*>(from)));
+        static_cast<Fn*>(from)->~Fn();
+      },
+      [](void* s) { static_cast<Fn*>(s)->~Fn(); },
+  };
+  template <typename Fn>
+  static constexpr Ops heap_ops = {
+      [](void* s) { (**static_cast<Fn**>(s))(); },
+      [](void* to, void* from) {
+        *static_cast<Fn**>(to) = *static_cast<Fn**>(from);
+      },
+      [](void* s) { delete *static_cast<Fn**>(s); },
+  };
+
+  void take(SmallFunction& other) {
+    ops = other.ops;
+    if (ops != nullptr) {
+      ops->relocate(storage, other.storage);
+      other.ops = nullptr;
+    }
+  }
+
+  alignas(max_align_t) unsigned char storage[capacity];
+  const Ops* ops = nullptr;
+};
+
+// teardown functions run in reverse order at exit, plus destruction that is
+// deferred at runtime until the gpu is done with the object
+struct DeletionQueue {
+  struct Deferred {
+    u64 last_used_value;
+    SmallFunction fn;
+  };
+
+  vector<SmallFunction> cleanup_functions;
+  // ordered by `last_used_value`, since timeline values only grow
+  deque<Deferred> deferred;
 
   void init();
   // move semantics
   // since lambdas as an argument are rvalues, can take ownership instead of
   // copying
-  void push(function<void()>&& fn);
-
-  // flush from back first
+  void push(SmallFunction&& fn);
+  // runs `fn` once the submission that signals timeline value
+  // `last_used_value` has finished on the gpu
+  void defer(u64 last_used_value, SmallFunction&& fn);
+  // runs everything whose last use is at or before `completed`, the value
+  // the timeline has reached
+  void collect(u64 completed);
+
+  // deferred first (the device is idle by then), then flush from back first
   void flush();
 };
 
@@ -109,3 +218,11 @@ struct Vertex {
   glm::vec3 coord;
   glm::vec3 color;
 };
+
+// per instance vertex attributes of VertexLayout::position_color_instanced,
+// matches the instance inputs of instanced.vert
+struct InstanceData {
+  glm::mat4 transform = glm::mat4(1.f);
+  // multiplies the vertex color
+  glm::vec4 color = glm::vec4(1.f);
+};
@@ -1,12 +1,13 @@
 #include "app.hpp"
 
-int main() {
+int main(int argc, char** argv) {
   App app;
   try {
+    app.options = Options::parse(argc, argv);
     app.run();
   } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
     return EXIT_FAILURE;
   }
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,106 @@
+#include "memory_stats.hpp"
+
+MemoryStats MemoryStats::collect(VmaAllocator allocator,
+                                 bool budget_extension,
+                                 u64 frame_number) {
+  MemoryStats stats = {.budget_extension = budget_extension,
+                       .frame_number = frame_number};
+
+  const VkPhysicalDeviceMemoryProperties* memory_properties;
+  vmaGetMemoryProperties(allocator, &memory_properties);
+
+  vector<VmaBudget> budgets(memory_properties->memoryHeapCount);
+  vmaGetHeapBudgets(allocator, budgets.data());
+  // walks every block, too slow to do every frame
+  VmaTotalStatistics total;
+  vmaCalculateStatistics(allocator, &total);
+
+  for (u32 i = 0; i < memory_properties->memoryHeapCount; i++) {
+    const VkMemoryHeap& heap = memory_properties->memoryHeaps[i];
+    const VmaDetailedStatistics& detailed = total.memoryHeap[i];
+    VkDeviceSize free_bytes =
+        detailed.statistics.blockBytes - detailed.statistics.allocationBytes;
+    VkDeviceSize largest_free_range =
+        detailed.unusedRangeCount > 0 ? detailed.unusedRangeSizeMax : 0;
+
+    stats.heaps.push_back({
+        .heap_index = i,
+        .size = heap.size,
+        .device_local = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+        .usage = budgets[i].usage,
+        .budget = budgets[i].budget,
+        .block_bytes = detailed.statistics.blockBytes,
+        .allocation_bytes = detailed.statistics.allocationBytes,
+        .block_count = detailed.statistics.blockCount,
+        .allocation_count = detailed.statistics.allocationCount,
+        .unused_range_count = detailed.unusedRangeCount,
+        .largest_free_range = largest_free_range,
+        .fragmentation =
+            free_bytes > 0 ? 1.0 - static_cast<double>(largest_free_range) /
+                                       static_cast<double>(free_bytes)
+                           : 0.0,
+    });
+  }
+  return stats;
+}
+
+static double mib(VkDeviceSize bytes) {
+  return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+void MemoryStats::print_summary() const {
+  for (auto& heap : heaps) {
+    println(
+        "heap {}{}: {:.1f}/{:.1f} MiB used ({:.0f}%), {} allocations in {} "
+        "blocks, largest free {:.1f} MiB, fragmentation {:.2f}",
+        heap.heap_index, heap.device_local ? " (device)" : "", mib(heap.usage),
+        mib(heap.budget),
+        heap.budget > 0 ? 100.0 * heap.usage / heap.budget : 0.0,
+        heap.allocation_count, heap.block_count,
+        mib(heap.largest_free_range), heap.fragmentation);
+  }
+}
+
+string MemoryStats::to_json(VmaAllocator allocator) const {
+  string json = fmt::format(
+      "{{\n  \"budget_extension\": {},\n  \"frame_number\": {},\n"
+      "  \"heaps\": [",
+      budget_extension, frame_number);
+  for (size_t i = 0; i < heaps.size(); i++) {
+    const HeapStats& heap = heaps[i];
+    json += fmt::format(
+        "{}\n    {{\"index\": {}, \"size\": {}, \"device_local\": {}, "
+        "\"usage\": {}, \"budget\": {}, \"block_bytes\": {}, "
+        "\"allocation_bytes\": {}, \"block_count\": {}, "
+        "\"allocation_count\": {}, \"unused_range_count\": {}, "
+        "\"largest_free_range\": {}, \"fragmentation\": {:.4f}}}",
+        i == 0 ? "" : ",", heap.heap_index, heap.size, heap.device_local,
+        heap.usage, heap.budget, heap.block_bytes, heap.allocation_bytes,
+        heap.block_count, heap.allocation_count, heap.unused_range_count,
+        heap.largest_free_range, heap.fragmentation);
+  }
+  json += "\n  ]";
+
+  if (allocator != VK_NULL_HANDLE) {
+    // already json
+    char* detailed;
+    vmaBuildStatsString(allocator, &detailed, VK_TRUE);
+    json += fmt::format(",\n  \"vma\": {}", detailed);
+    vmaFreeStatsString(allocator, detailed);
+  }
+  json += "\n}\n";
+  return json;
+}
+
+void MemoryStats::write_json(const path& file, VmaAllocator allocator) const {
+  if (file.has_parent_path()) {
+    create_directories(file.parent_path());
+  }
+  ofstream out(file, ios::trunc);
+  if (!out) {
+    println("unable to write memory stats to {}", file.string());
+    return;
+  }
+  out << to_json(allocator);
+  println("wrote memory stats to {}", file.string());
+}
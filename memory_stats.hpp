@@ -0,0 +1,39 @@
+#pragma once
+
+#include "lib.hpp"
+
+struct HeapStats {
+  u32 heap_index;
+  VkDeviceSize size;
+  bool device_local;
+  // what the process uses / may use before the os starts evicting. only
+  // driver-accurate with VK_EXT_memory_budget, vma estimates otherwise
+  VkDeviceSize usage;
+  VkDeviceSize budget;
+  // memory vma allocated from vulkan vs what's handed out of it
+  VkDeviceSize block_bytes;
+  VkDeviceSize allocation_bytes;
+  u32 block_count;
+  u32 allocation_count;
+  u32 unused_range_count;
+  VkDeviceSize largest_free_range;
+  // 0 when the free space inside blocks is one range, approaching 1 the
+  // more it is split up
+  double fragmentation;
+};
+
+// snapshot of vma's per-heap statistics
+struct MemoryStats {
+  bool budget_extension = false;
+  u64 frame_number = 0;
+  vector<HeapStats> heaps;
+
+  static MemoryStats collect(VmaAllocator allocator,
+                             bool budget_extension,
+                             u64 frame_number);
+  // one line per heap
+  void print_summary() const;
+  // includes vma's detailed map of every block when `allocator` is given
+  string to_json(VmaAllocator allocator = VK_NULL_HANDLE) const;
+  void write_json(const path& file, VmaAllocator allocator) const;
+};
@@ -0,0 +1,147 @@
+#include "options.hpp"
+
+// the part after `--name=`, if `arg` is that option
+static optional<string> value_of(const string& arg, const string& name) {
+  string prefix = name + "=";
+  if (arg.rfind(prefix, 0) != 0) {
+    return nullopt;
+  }
+  return arg.substr(prefix.size());
+}
+
+static VkPresentModeKHR parse_present_mode(const string& value) {
+  if (value == "fifo") {
+    return VK_PRESENT_MODE_FIFO_KHR;
+  } else if (value == "mailbox") {
+    return VK_PRESENT_MODE_MAILBOX_KHR;
+  } else if (value == "immediate") {
+    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  }
+  throw runtime_error(
+      fmt::format("present mode {} isn't fifo, mailbox or immediate", value));
+}
+
+// `WIDTHxHEIGHT`
+static void parse_size(const string& value, u32& width, u32& height) {
+  size_t separator = value.find('x');
+  if (separator == string::npos) {
+    throw runtime_error(fmt::format("size {} isn't WIDTHxHEIGHT", value));
+  }
+  width = static_cast<u32>(stoul(value.substr(0, separator)));
+  height = static_cast<u32>(stoul(value.substr(separator + 1)));
+  if (width == 0 || height == 0) {
+    throw runtime_error(fmt::format("size {} is empty", value));
+  }
+}
+
+Options Options::parse(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    optional<string> value;
+    if (arg == "--dynamic-rendering") {
+      options.dynamic_rendering = true;
+    } else if (arg == "--render-pass") {
+      options.dynamic_rendering = false;
+    } else if (arg == "--extended-dynamic-state") {
+      options.extended_dynamic_state = true;
+    } else if (arg == "--baked-state") {
+      options.extended_dynamic_state = false;
+    } else if ((value = value_of(arg, "--memory-stats"))) {
+      options.memory_stats_path = value.value();
+    } else if ((value = value_of(arg, "--memory-report-interval"))) {
+      options.memory_report_interval = stod(value.value());
+    } else if ((value = value_of(arg, "--render-target-idle"))) {
+      options.render_target_idle_seconds = stod(value.value());
+    } else if (arg == "--track-host-allocations") {
+      options.track_host_allocations = true;
+    } else if ((value = value_of(arg, "--command-arena"))) {
+      options.command_arena_size = stoull(value.value());
+    } else if (arg == "--headless") {
+      options.headless = true;
+    } else if ((value = value_of(arg, "--size"))) {
+      parse_size(value.value(), options.width, options.height);
+    } else if ((value = value_of(arg, "--frames"))) {
+      options.frames = stoull(value.value());
+    } else if ((value = value_of(arg, "--capture"))) {
+      options.capture_path = value.value();
+    } else if ((value = value_of(arg, "--bench"))) {
+      options.bench_frames = stoull(value.value());
+    } else if ((value = value_of(arg, "--bench-warmup"))) {
+      options.bench_warmup = stoull(value.value());
+    } else if ((value = value_of(arg, "--bench-output"))) {
+      options.bench_output = value.value();
+    } else if ((value = value_of(arg, "--record-threads"))) {
+      options.record_threads = static_cast<u32>(stoul(value.value()));
+    } else if ((value = value_of(arg, "--draws"))) {
+      options.draws = static_cast<u32>(stoul(value.value()));
+    } else if ((value = value_of(arg, "--instances"))) {
+      options.instances = static_cast<u32>(stoul(value.value()));
+    } else if (arg == "--indirect-draws") {
+      options.indirect_draws = true;
+    } else if (arg == "--reuse-command-buffers") {
+      options.reuse_command_buffers = true;
+    } else if ((value = value_of(arg, "--present-mode"))) {
+      options.present_mode = parse_present_mode(value.value());
+    } else if ((value = value_of(arg, "--frames-in-flight"))) {
+      options.frames_in_flight = static_cast<u32>(stoul(value.value()));
+    } else if (arg == "--present-wait") {
+      options.present_wait = true;
+    } else if ((value = value_of(arg, "--trace"))) {
+      options.trace_path = value.value();
+    } else if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      exit(EXIT_SUCCESS);
+    } else {
+      print_usage(argv[0]);
+      throw runtime_error(fmt::format("unknown argument {}", arg));
+    }
+  }
+  // swapchain images can't be copied from
+  if (!options.capture_path.empty() && !options.headless) {
+    throw runtime_error("--capture needs --headless");
+  }
+  if (options.frames_in_flight < 1 ||
+      options.frames_in_flight > MAX_IN_FLIGHT_FRAMES) {
+    throw runtime_error(fmt::format("--frames-in-flight must be 1 to {}",
+                                    MAX_IN_FLIGHT_FRAMES));
+  }
+  return options;
+}
+
+void Options::print_usage(const char* program) {
+  println("usage: {} [options]", program);
+  println("  --dynamic-rendering  render with vkCmdBeginRendering (default)");
+  println("  --render-pass        render with a VkRenderPass and framebuffers");
+  println("  --extended-dynamic-state");
+  println("                       set raster and depth state per draw");
+  println("  --baked-state        bake raster and depth state into pipelines");
+  println("  --memory-stats=PATH  write memory stats as json at exit (and F9)");
+  println("  --memory-report-interval=SECONDS");
+  println("                       print heap usage and budget periodically");
+  println("  --render-target-idle=SECONDS");
+  println("                       keep unused render targets this long (2)");
+  println("  --track-host-allocations");
+  println("                       print driver host allocations at exit");
+  println("  --command-arena=BYTES");
+  println("                       serve command scope allocations from a");
+  println("                       per-frame arena (with tracking)");
+  println("  --headless           render offscreen, without a window");
+  println("  --size=WIDTHxHEIGHT  window or offscreen image size (800x600)");
+  println("  --frames=N           exit after N frames (headless default 1)");
+  println("  --capture=PATH       write the last frame as ppm (headless)");
+  println("  --bench=N            time N frames, print and write percentiles");
+  println("  --bench-warmup=N     untimed frames before the benchmark (60)");
+  println("  --bench-output=PATH  benchmark json (bench.json)");
+  println("  --record-threads=N   threads recording draws (workers + 1)");
+  println("  --draws=N            repeat the scene's draw N times (1)");
+  println("  --instances=N        draw N copies in one instanced draw (0)");
+  println("  --indirect-draws     draw batches with vkCmdDrawIndirectCount");
+  println("  --reuse-command-buffers");
+  println("                       re-record frames only after changes");
+  println("  --present-mode=fifo|mailbox|immediate");
+  println("                       swapchain present mode (fifo)");
+  println("  --frames-in-flight=N frames the cpu may run ahead, 1 to 3 (2)");
+  println("  --present-wait       pace frames on VK_KHR_present_wait");
+  println("  --trace=PATH         write cpu spans as a chrome trace at exit");
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "lib.hpp"
+
+// command line switches, parsed once in main before anything is created
+struct Options {
+  // render with vkCmdBeginRendering and explicit barriers instead of a
+  // VkRenderPass plus one VkFramebuffer per swapchain image
+  bool dynamic_rendering = true;
+  // cull mode, front face, depth state and topology are set per draw, so
+  // draws that only differ in those share a pipeline
+  bool extended_dynamic_state = true;
+  // json memory report written at teardown, empty for none. F9 writes one
+  // on demand (to memory_stats.json if this is empty)
+  path memory_stats_path;
+  // seconds between per-heap usage/budget lines, 0 for never
+  double memory_report_interval = 0;
+  // how long a render target left over from a resize is kept for reuse
+  double render_target_idle_seconds = 2;
+  // count driver host allocations through VkAllocationCallbacks and print
+  // them at exit
+  bool track_host_allocations = false;
+  // bytes of per-frame arena for command scope host allocations, 0 for the
+  // heap. only used while tracking
+  size_t command_arena_size = 0;
+  // no window, surface or swapchain. frames go to offscreen images, for ci
+  // (lavapipe) and server side rendering
+  bool headless = false;
+  // initial window size, or the offscreen image size when headless
+  u32 width = WIDTH;
+  u32 height = HEIGHT;
+  // stop after this many frames, 0 runs until the window is closed (or a
+  // single frame when headless)
+  u64 frames = 0;
+  // the last frame as a binary ppm, headless only
+  path capture_path;
+  // --bench=N: time N frames after `bench_warmup` untimed ones, then print
+  // a summary, write it as json and exit
+  u64 bench_frames = 0;
+  u64 bench_warmup = 60;
+  path bench_output = "bench.json";
+  // threads recording the draw list into secondary command buffers. 0 is
+  // the worker pool plus the main thread, 1 records everything inline
+  u32 record_threads = 0;
+  // repeats the scene's draw this many times, to load the cpu side
+  u32 draws = 1;
+  // adds one instanced draw of this many small copies of the scene's mesh,
+  // laid out in a grid
+  u32 instances = 0;
+  // one vkCmdDrawIndirectCount per batch of draws sharing pipeline and
+  // state instead of a vkCmdDraw per draw
+  bool indirect_draws = false;
+  // submit the frame command buffer recorded for the same slot and image
+  // again until the scene, pipelines or swapchain change
+  bool reuse_command_buffers = false;
+  // FIFO is vsynced and always supported, MAILBOX replaces queued images
+  // with newer ones, IMMEDIATE doesn't wait for vblank and may tear.
+  // unsupported modes fall back to FIFO
+  VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+  // 1 to MAX_IN_FLIGHT_FRAMES. fewer trades cpu/gpu overlap for latency
+  u32 frames_in_flight = 2;
+  // don't start a frame until the one `frames_in_flight` back is on screen
+  // (VK_KHR_present_wait), ignored where unsupported and when headless
+  bool present_wait = false;
+  // cpu spans of init, frame phases and shader compilation as a chrome
+  // trace
+  path trace_path;
+
+  // throws on anything it doesn't recognize
+  static Options parse(int argc, char** argv);
+  static void print_usage(const char* program);
+};
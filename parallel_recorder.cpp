@@ -0,0 +1,77 @@
+#include "parallel_recorder.hpp"
+
+#include "trace.hpp"
+
+void ParallelRecorder::init(FrameCommandPools* command_pools) {
+  this->command_pools = command_pools;
+  max_chunks = max(command_pools->lane_count(), 1u);
+  if (max_chunks > 1) {
+    workers.init(max_chunks - 1, "record worker");
+  }
+}
+
+void ParallelRecorder::destroy() {
+  workers.shutdown();
+}
+
+u32 ParallelRecorder::chunk_count(size_t draw_count) const {
+  size_t chunks = min<size_t>(max_chunks, draw_count / min_draws_per_chunk);
+  return static_cast<u32>(max<size_t>(chunks, 1));
+}
+
+vector<VkCommandBuffer> ParallelRecorder::record(
+    const VkCommandBufferInheritanceInfo& inheritance,
+    size_t draw_count,
+    const RecordFn& record_fn) {
+  u32 chunks = chunk_count(draw_count);
+  vector<VkCommandBuffer> command_buffers(chunks);
+
+  auto record_chunk = [&](u32 chunk) {
+    size_t begin = draw_count * chunk / chunks;
+    size_t end = draw_count * (chunk + 1) / chunks;
+    TRACE_SCOPE("record chunk", "{} draws", end - begin);
+    VkCommandBuffer command_buffer =
+        command_pools->allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY, chunk);
+    command_buffers[chunk] = command_buffer;
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                 VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance,
+    };
+    VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info),
+             "unable to begin secondary command buffer");
+    record_fn(command_buffer, begin, end);
+    VK_CHECK(vkEndCommandBuffer(command_buffer),
+             "unable to end secondary command buffer");
+  };
+
+  vector<future<void>> pending;
+  pending.reserve(chunks - 1);
+  for (u32 chunk = 1; chunk < chunks; chunk++) {
+    pending.push_back(
+        workers.submit([&record_chunk, chunk]() { record_chunk(chunk); }));
+  }
+  // the main thread takes a chunk too instead of idling
+  exception_ptr error;
+  try {
+    record_chunk(0);
+  } catch (...) {
+    error = current_exception();
+  }
+  // every worker has to be done with `record_chunk` before it goes away
+  for (auto& p : pending) {
+    try {
+      p.get();
+    } catch (...) {
+      if (!error) {
+        error = current_exception();
+      }
+    }
+  }
+  if (error) {
+    rethrow_exception(error);
+  }
+
+  return command_buffers;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "command_pools.hpp"
+#include "lib.hpp"
+#include "thread_pool.hpp"
+
+// records a frame's draw list into secondary command buffers on its own
+// threads, one contiguous chunk of draws each, for the main thread to execute
+// in order. command pools can't be used from two threads at once, so chunk
+// i allocates from lane i of the frame's command pools.
+struct ParallelRecorder {
+  // records draws [begin, end) into a command buffer that is already begun
+  using RecordFn =
+      function<void(VkCommandBuffer command_buffer, size_t begin, size_t end)>;
+
+  FrameCommandPools* command_pools = nullptr;
+  // one per lane of `command_pools`, 1 disables parallel recording
+  u32 max_chunks = 1;
+  // fewer draws per chunk and the cost of an extra command buffer outweighs
+  // recording it in parallel
+  size_t min_draws_per_chunk = 256;
+  // not the shared pool, where a frame would wait behind pipeline builds.
+  // one thread per chunk past the first, which the calling thread records
+  ThreadPool workers;
+
+  void init(FrameCommandPools* command_pools);
+  void destroy();
+
+  // how many chunks `draw_count` draws are split into, 1 means recording
+  // them inline is cheaper
+  u32 chunk_count(size_t draw_count) const;
+  // records [0, draw_count) in `chunk_count(draw_count)` secondary command
+  // buffers from the current frame's pools, the first one on the calling
+  // thread. returns them in draw order, ready for vkCmdExecuteCommands
+  vector<VkCommandBuffer> record(
+      const VkCommandBufferInheritanceInfo& inheritance,
+      size_t draw_count,
+      const RecordFn& record_fn);
+};
@@ -1,4 +1,7 @@
 #include "pipeline.hpp"
+#include "embedded_shaders.hpp"
+#include "host_allocator.hpp"
+#include "trace.hpp"
 #include <cstddef>
 #include <glm/ext/vector_float3.hpp>
 #include "lib.hpp"
@@ -32,6 +35,49 @@ optional<string> Pipeline::read_to_string(path p) {
   return output;
 }
 
+optional<VkShaderModule> Pipeline::create_shader_module(
+    const u32* words,
+    size_t word_count,
+    const string& shader_name,
+    VkDevice device) {
+  VkShaderModuleCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      // sizeof(u32) is 4
+      .codeSize = word_count * sizeof(u32),
+      .pCode = words};
+
+  VkShaderModule module;
+  if (vkCreateShaderModule(device, &create_info,
+                           vk_allocator(VK_OBJECT_TYPE_SHADER_MODULE),
+                           &module) != VK_SUCCESS) {
+    println("unable to create shader module for {}", shader_name);
+    return {};
+  }
+  return module;
+}
+
+optional<VkShaderModule> Pipeline::get_compiled_shader_module(
+    string shader_name,
+    VkDevice device) {
+  TRACE_SCOPE("shader module", "{}", shader_name);
+  // spirv compiled at build time needs neither file io nor shaderc
+  optional<EmbeddedShader> embedded = find_embedded_shader(shader_name);
+  if (embedded.has_value() && !prefer_shader_sources) {
+    return create_shader_module(embedded->words, embedded->word_count,
+                               shader_name, device);
+  }
+
+#ifdef RUNTIME_SHADER_COMPILER
+  return compile_shader_module(shader_name, shaderc_glsl_infer_from_source,
+                               device);
+#else
+  println("{} was not embedded and runtime shader compilation is disabled",
+          shader_name);
+  return {};
+#endif
+}
+
+#ifdef RUNTIME_SHADER_COMPILER
 // function basically copied from
 // https://github.com/google/shaderc/blob/main/examples/online-compile/main.cc
 optional<vector<u32>> Pipeline::get_spirv_from_glsl(
@@ -39,8 +85,14 @@ optional<vector<u32>> Pipeline::get_spirv_from_glsl(
     shaderc_shader_kind kind,
     const std::string& source_path,
     bool optimize) {
-  shaderc::Compiler compiler;
+  TRACE_SCOPE("shaderc", "{}", source_path);
+  // a compiler per thread, so stages can be compiled in parallel without
+  // sharing (or reconstructing) one
+  thread_local shaderc::Compiler compiler;
   shaderc::CompileOptions options;
+  // buffer references and draw parameters, same as the build time glslc
+  options.SetTargetEnvironment(shaderc_target_env_vulkan,
+                               shaderc_env_version_vulkan_1_3);
 
   // optimize the compiled shader binary if needed
   if (optimize) {
@@ -70,7 +122,7 @@ optional<vector<u32>> Pipeline::get_spirv_from_glsl(
     return {};
   }
 }
-optional<VkShaderModule> Pipeline::get_compiled_shader_module(
+optional<VkShaderModule> Pipeline::compile_shader_module(
     string shader_name,
     shaderc_shader_kind shader_kind,
     VkDevice device) {
@@ -83,140 +135,347 @@ optional<VkShaderModule> Pipeline::get_compiled_shader_module(
     return {};
   }
 
-  optional<vector<u32>> spirv = get_spirv_from_glsl(
-      source_code.value(), shader_kind, source_path.string());
+  // only hit shaderc if this exact source has never been compiled before
+  bool optimize = false;
+  u64 cache_key = shader_cache.key(source_code.value(), source_path,
+                                   shader_kind, optimize);
+  optional<SpirvBlob> spirv = shader_cache.load(cache_key);
 
   if (!spirv.has_value()) {
-    println("unable to compile spirv for {}", shader_name);
-    return {};
+    optional<vector<u32>> compiled = get_spirv_from_glsl(
+        source_code.value(), shader_kind, source_path.string(), optimize);
+
+    if (!compiled.has_value()) {
+      println("unable to compile spirv for {}", shader_name);
+      return {};
+    }
+    shader_cache.store(cache_key, compiled.value());
+    spirv = SpirvBlob(std::move(compiled.value()));
   }
 
-  VkShaderModuleCreateInfo create_info = {
-      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-      // sizeof(u32) is 4
-      .codeSize = spirv.value().size() * sizeof(u32),
-      .pCode = spirv.value().data()};
+  return create_shader_module(spirv.value().words, spirv.value().word_count,
+                              shader_name, device);
+}
+#endif
 
-  VkShaderModule module;
-  vkCreateShaderModule(device, &create_info, nullptr, &module);
-  return module;
+size_t PipelineKeyHash::operator()(const PipelineKey& key) const {
+  // fnv-1a over the packed key
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+  u64 hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < sizeof(PipelineKey); i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return static_cast<size_t>(hash);
 }
 
-void Pipeline::create_shader_stages(VkDevice device) {
-  optional<VkShaderModule> vert_module = get_compiled_shader_module(
-      "main.vert", shaderc_glsl_infer_from_source, device);
-  if (!vert_module.has_value()) {
-    throw runtime_error("unable to create vertex shader module");
+static VkPrimitiveTopology topology_class(VkPrimitiveTopology topology) {
+  switch (topology) {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+      return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+      return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+      return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+    default:
+      return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   }
+}
 
-  optional<VkShaderModule> frag_module = get_compiled_shader_module(
-      "main.frag", shaderc_glsl_infer_from_source, device);
+PipelineKey PipelineKey::with_extended_dynamic_state() const {
+  PipelineKey key = *this;
+  key.extended_dynamic_state = VK_TRUE;
+  key.topology =
+      topology_class(static_cast<VkPrimitiveTopology>(key.topology));
+  key.cull_mode = 0;
+  key.front_face = 0;
+  key.depth_test = 0;
+  key.depth_write = 0;
+  key.depth_compare = 0;
+  return key;
+}
 
-  if (!frag_module.has_value()) {
-    throw runtime_error("unable to create fragment shader module");
+ShaderModules::~ShaderModules() {
+  for (auto& [name, module] : modules) {
+    optional<VkShaderModule> m = module.get();
+    if (m.has_value()) {
+      vkDestroyShaderModule(device, m.value(),
+                            vk_allocator(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
   }
+}
 
-  vector<VkPipelineShaderStageCreateInfo> shader_stages = {
-      {
-          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-          .stage = VK_SHADER_STAGE_VERTEX_BIT,
-          .module = vert_module.value(),
-          .pName = "main",
-      },
-      {
-          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-          .module = frag_module.value(),
-          .pName = "main",
-      },
+void Pipeline::init(VkDevice device) {
+#ifdef RUNTIME_SHADER_COMPILER
+  shader_cache.init(get_current_working_dir() / ".cache" / "spirv");
+#endif
+
+  // # pipeline layout (for uniforms?)
+  // shared by every pipeline
+  const VkPushConstantRange draw_constants = {
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+      .offset = 0,
+      .size = sizeof(DrawConstants),
+  };
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 0,     // Optional
+      .pSetLayouts = nullptr,  // Optional
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &draw_constants,
   };
-  this->shader_stages = shader_stages;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo,
+                             vk_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT),
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw runtime_error("failed to create pipeline layout!");
+  }
+  deletion_queue.push([=, this]() {
+    vkDestroyPipelineLayout(device, this->pipelineLayout,
+                            vk_allocator(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+  });
+
+  invalidate_shader_modules(device);
+  // release the last generation before the device goes away
+  deletion_queue.push([this]() {
+    lock_guard lock(this->shader_modules_mutex);
+    this->shader_modules.reset();
+  });
 }
-void Pipeline::create_dynamic_state() {
-  this->dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
 
-  this->dynamic_state = {
-      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-      .dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
-      .pDynamicStates = this->dynamic_states.data()};
+shared_ptr<ShaderModules> Pipeline::current_shader_modules() {
+  lock_guard lock(shader_modules_mutex);
+  return shader_modules;
+}
+
+void Pipeline::invalidate_shader_modules(VkDevice device) {
+  auto modules = make_shared<ShaderModules>();
+  modules->device = device;
+  lock_guard lock(shader_modules_mutex);
+  shader_modules = modules;
+}
+
+optional<VkShaderModule> Pipeline::get_shader_module(
+    ShaderModules& modules,
+    const string& shader_name) {
+  promise<optional<VkShaderModule>> compiled;
+  shared_future<optional<VkShaderModule>> module;
+  bool compile_here = false;
+  {
+    lock_guard lock(modules.modules_mutex);
+    auto it = modules.modules.find(shader_name);
+    if (it == modules.modules.end()) {
+      it = modules.modules.emplace(shader_name, compiled.get_future().share())
+               .first;
+      compile_here = true;
+    }
+    module = it->second;
+  }
+  if (!compile_here) {
+    // whoever got here first is compiling it, wait outside of the lock
+    return module.get();
+  }
+
+  // compile on this thread rather than on the pool, a build waiting on a
+  // queued task could otherwise starve the pool
+  optional<VkShaderModule> result =
+      get_compiled_shader_module(shader_name, modules.device);
+  compiled.set_value(result);
+  return result;
+}
+
+void Pipeline::compile_shader_stages(const vector<string>& shader_names,
+                                     ThreadPool& workers) {
+  shared_ptr<ShaderModules> modules = current_shader_modules();
+  for (auto& shader_name : shader_names) {
+    workers.submit([this, modules, shader_name]() {
+      get_shader_module(*modules, shader_name);
+    });
+  }
 }
-void Pipeline::create_vertex_input_info() {
-  vertex_binding_descriptions = {
-      {.binding = 0,
-       .stride = sizeof(Vertex),
-       .inputRate = VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX},
-  };
 
-  vertex_attribute_descriptions = {
-      // vertex
-      {.location = 0,
-       .binding = 0,
-       .format = VK_FORMAT_R32G32B32_SFLOAT,
-       .offset = offsetof(Vertex, coord)},
-      // color
-      {.location = 1,
-       .binding = 0,
-       .format = VK_FORMAT_R32G32B32_SFLOAT,
-       .offset = offsetof(Vertex, color)},
+void Pipeline::create_shader_stages(BuildState& state,
+                                    ShaderModules& modules,
+                                    const string& vertex_shader,
+                                    const string& fragment_shader) {
+  vector<pair<string, VkShaderStageFlagBits>> stages = {
+      {vertex_shader, VK_SHADER_STAGE_VERTEX_BIT},
+      {fragment_shader, VK_SHADER_STAGE_FRAGMENT_BIT},
   };
 
-  vertex_input_info = {
+  state.shader_stages.clear();
+  for (auto& [shader_name, stage] : stages) {
+    optional<VkShaderModule> module = get_shader_module(modules, shader_name);
+    // not necessarily fatal, hot reload keeps running with the previous
+    // pipeline
+    if (!module.has_value()) {
+      throw runtime_error(
+          fmt::format("unable to create shader module for {}", shader_name));
+    }
+
+    state.shader_stages.push_back({
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = stage,
+        .module = module.value(),
+        .pName = "main",
+    });
+  }
+}
+void Pipeline::create_dynamic_state(BuildState& state, const PipelineKey& key) {
+  state.dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT,
+                          VK_DYNAMIC_STATE_SCISSOR};
+  if (key.extended_dynamic_state) {
+    // core since 1.3, no feature to enable
+    state.dynamic_states.insert(state.dynamic_states.end(),
+                                {VK_DYNAMIC_STATE_CULL_MODE,
+                                 VK_DYNAMIC_STATE_FRONT_FACE,
+                                 VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+                                 VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+                                 VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+                                 VK_DYNAMIC_STATE_DEPTH_COMPARE_OP});
+  }
+
+  state.dynamic_state = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = static_cast<uint32_t>(state.dynamic_states.size()),
+      .pDynamicStates = state.dynamic_states.data()};
+}
+void Pipeline::create_vertex_input_info(BuildState& state,
+                                        const PipelineKey& key) {
+  switch (key.vertex_layout) {
+    case VertexLayout::position_color:
+      state.vertex_binding_descriptions = {
+          {.binding = 0,
+           .stride = sizeof(Vertex),
+           .inputRate = VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX},
+      };
+
+      state.vertex_attribute_descriptions = {
+          // vertex
+          {.location = 0,
+           .binding = 0,
+           .format = VK_FORMAT_R32G32B32_SFLOAT,
+           .offset = offsetof(Vertex, coord)},
+          // color
+          {.location = 1,
+           .binding = 0,
+           .format = VK_FORMAT_R32G32B32_SFLOAT,
+           .offset = offsetof(Vertex, color)},
+      };
+      break;
+    case VertexLayout::position_color_instanced:
+      state.vertex_binding_descriptions = {
+          {.binding = 0,
+           .stride = sizeof(Vertex),
+           .inputRate = VkVertexInputRate::VK_VERTEX_INPUT_RATE_VERTEX},
+          {.binding = 1,
+           .stride = sizeof(InstanceData),
+           .inputRate = VkVertexInputRate::VK_VERTEX_INPUT_RATE_INSTANCE},
+      };
+
+      state.vertex_attribute_descriptions = {
+          // vertex
+          {.location = 0,
+           .binding = 0,
+           .format = VK_FORMAT_R32G32B32_SFLOAT,
+           .offset = offsetof(Vertex, coord)},
+          // color
+          {.location = 1,
+           .binding = 0,
+           .format = VK_FORMAT_R32G32B32_SFLOAT,
+           .offset = offsetof(Vertex, color)},
+      };
+      // a mat4 takes a location per column
+      for (u32 column = 0; column < 4; column++) {
+        state.vertex_attribute_descriptions.push_back(
+            {.location = 2 + column,
+             .binding = 1,
+             .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+             .offset = static_cast<u32>(offsetof(InstanceData, transform) +
+                                        sizeof(glm::vec4) * column)});
+      }
+      // instance color
+      state.vertex_attribute_descriptions.push_back(
+          {.location = 6,
+           .binding = 1,
+           .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+           .offset = offsetof(InstanceData, color)});
+      break;
+  }
+
+  state.vertex_input_info = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
       .vertexBindingDescriptionCount =
-          static_cast<u32>(vertex_binding_descriptions.size()),
-      .pVertexBindingDescriptions = vertex_binding_descriptions.data(),
+          static_cast<u32>(state.vertex_binding_descriptions.size()),
+      .pVertexBindingDescriptions = state.vertex_binding_descriptions.data(),
       .vertexAttributeDescriptionCount =
-          static_cast<u32>(vertex_attribute_descriptions.size()),
-      .pVertexAttributeDescriptions = vertex_attribute_descriptions.data(),
+          static_cast<u32>(state.vertex_attribute_descriptions.size()),
+      .pVertexAttributeDescriptions =
+          state.vertex_attribute_descriptions.data(),
   };
 }
 
-void Pipeline::create_input_assembly() {
+void Pipeline::create_input_assembly(BuildState& state,
+                                     const PipelineKey& key) {
   VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+      .topology = static_cast<VkPrimitiveTopology>(key.topology),
       .primitiveRestartEnable = VK_FALSE,
   };
-  this->inputAssembly = inputAssembly;
+  state.inputAssembly = inputAssembly;
+}
+
+void Pipeline::report_creation_feedback(
+    const VkPipelineCreationFeedback& feedback,
+    double elapsed_ms) {
+  if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT)) {
+    // driver doesn't report feedback, fall back to wall clock only
+    println("pipeline created in {:.2f}ms", elapsed_ms);
+    return;
+  }
+  bool hit = feedback.flags &
+             VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
+  println("pipeline created in {:.2f}ms (driver: {:.2f}ms, cache {})",
+          elapsed_ms, feedback.duration / 1e6, hit ? "hit" : "miss");
 }
 
-vector<VkPipeline> Pipeline::create(VkDevice& device,
-                                    SwapchainDimensions& swapchain_dimensions,
-                                    VkRenderPass& render_pass) {
-  create_shader_stages(device);
-  create_dynamic_state();
-  create_vertex_input_info();
+VkPipeline Pipeline::create(VkDevice device,
+                            const PipelineKey& key,
+                            const string& vertex_shader,
+                            const string& fragment_shader,
+                            VkRenderPass render_pass,
+                            VkPipelineCache pipeline_cache) {
+  TRACE_SCOPE("create pipeline", "{} + {}", vertex_shader, fragment_shader);
+  // keeps this generation's modules alive for the duration of the build
+  shared_ptr<ShaderModules> modules = current_shader_modules();
+
+  BuildState state;
+  create_shader_stages(state, *modules, vertex_shader, fragment_shader);
+  create_dynamic_state(state, key);
+  create_vertex_input_info(state, key);
 
   // topology, or lack thereof
-  create_input_assembly();
+  create_input_assembly(state, key);
 
   // # viewport & scissors
-  VkViewport viewport = {
-      .x = 0.0f,
-      .y = 0.0f,
-      .width = (float)swapchain_dimensions.extent.width,
-      .height = (float)swapchain_dimensions.extent.height,
-      .minDepth = 0.0f,
-      .maxDepth = 1.0f,
-  };
+  // both dynamic, only the counts matter here
   VkPipelineViewportStateCreateInfo viewportState = {
       .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
       .viewportCount = 1,
       .scissorCount = 1,
   };
-  VkRect2D scissor = {
-      .offset = {0, 0},
-      .extent = swapchain_dimensions.extent,
-  };
 
   // # rasterizer
   VkPipelineRasterizationStateCreateInfo rasterizer{
       .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
       .depthClampEnable = VK_FALSE,
       .rasterizerDiscardEnable = VK_FALSE,
-      .polygonMode = VK_POLYGON_MODE_FILL,
-      .cullMode = VK_CULL_MODE_BACK_BIT,
-      .frontFace = VK_FRONT_FACE_CLOCKWISE,
+      .polygonMode = static_cast<VkPolygonMode>(key.polygon_mode),
+      .cullMode = key.cull_mode,
+      .frontFace = static_cast<VkFrontFace>(key.front_face),
       .depthBiasEnable = VK_FALSE,
       // depth bias apparently used for shadow mapping
       .depthBiasConstantFactor = VK_FALSE,
@@ -246,9 +505,9 @@ vector<VkPipeline> Pipeline::create(VkDevice& device,
       .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
       .pNext = NULL,
       .flags = 0,
-      .depthTestEnable = VK_TRUE,
-      .depthWriteEnable = VK_TRUE,
-      .depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL,
+      .depthTestEnable = key.depth_test,
+      .depthWriteEnable = key.depth_write,
+      .depthCompareOp = static_cast<VkCompareOp>(key.depth_compare),
       .depthBoundsTestEnable = VK_FALSE,
       .minDepthBounds = 0,
       .maxDepthBounds = 0,
@@ -269,6 +528,21 @@ vector<VkPipeline> Pipeline::create(VkDevice& device,
       .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,  // Optional
       .alphaBlendOp = VK_BLEND_OP_ADD,              // Optional
   };
+  switch (key.blend) {
+    case BlendMode::opaque:
+      break;
+    case BlendMode::alpha:
+      colorBlendAttachment.blendEnable = VK_TRUE;
+      colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+      colorBlendAttachment.dstColorBlendFactor =
+          VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+      break;
+    case BlendMode::additive:
+      colorBlendAttachment.blendEnable = VK_TRUE;
+      colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+      colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+      break;
+  }
 
   // # blending
   VkPipelineColorBlendStateCreateInfo colorBlending = {
@@ -283,36 +557,41 @@ vector<VkPipeline> Pipeline::create(VkDevice& device,
       .blendConstants[3] = 0.0f,  // Optional
   };
 
-  // # pipeline layout (for uniforms?)
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
-      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-      .setLayoutCount = 0,     // Optional
-      .pSetLayouts = nullptr,  // Optional
-      // push constants??
-      .pushConstantRangeCount = 0,     // Optional
-      .pPushConstantRanges = nullptr,  // Optional
+  // lets the driver tell us whether the pipeline cache was actually hit
+  VkPipelineCreationFeedback creation_feedback = {};
+  VkPipelineCreationFeedbackCreateInfo creation_feedback_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+      .pPipelineCreationFeedback = &creation_feedback,
   };
 
-  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
-                             &pipelineLayout) != VK_SUCCESS) {
-    throw runtime_error("failed to create pipeline layout!");
+  // without a render pass (dynamic rendering) the attachment formats come
+  // straight from the key
+  VkFormat color_format = key.color_format;
+  VkPipelineRenderingCreateInfo rendering_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .pNext = &creation_feedback_info,
+      .colorAttachmentCount = 1,
+      .pColorAttachmentFormats = &color_format,
+      .depthAttachmentFormat = key.depth_format,
+  };
+  void* pipeline_create_next = &creation_feedback_info;
+  if (render_pass == VK_NULL_HANDLE) {
+    pipeline_create_next = &rendering_info;
   }
-  deletion_stack.push([=, this]() {
-    vkDestroyPipelineLayout(device, this->pipelineLayout, nullptr);
-  });
 
   VkGraphicsPipelineCreateInfo pipeline_create_infos[] = {{
       .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-      .stageCount = 2,
-      .pStages = &shader_stages[0],
-      .pVertexInputState = &vertex_input_info,
-      .pInputAssemblyState = &inputAssembly,
+      .pNext = pipeline_create_next,
+      .stageCount = static_cast<u32>(state.shader_stages.size()),
+      .pStages = state.shader_stages.data(),
+      .pVertexInputState = &state.vertex_input_info,
+      .pInputAssemblyState = &state.inputAssembly,
       .pViewportState = &viewportState,
       .pRasterizationState = &rasterizer,
       .pMultisampleState = &multisampling,
       .pDepthStencilState = &depth_stencil,  // Optional
       .pColorBlendState = &colorBlending,
-      .pDynamicState = &dynamic_state,
+      .pDynamicState = &state.dynamic_state,
       .layout = pipelineLayout,
       .renderPass = render_pass,
       .subpass = 0,
@@ -320,17 +599,20 @@ vector<VkPipeline> Pipeline::create(VkDevice& device,
       .basePipelineIndex = -1                // optional
   }};
 
-  vector<VkPipeline> pipelines(1);
+  VkPipeline pipeline;
 
-  if (vkCreateGraphicsPipelines(device, nullptr, 1, &pipeline_create_infos[0],
-                                nullptr, pipelines.data()) != VK_SUCCESS) {
-    throw runtime_error("unable to create graphics pipeline");
-  }
+  auto start = chrono::steady_clock::now();
+  VkResult result = vkCreateGraphicsPipelines(
+      device, pipeline_cache, 1, &pipeline_create_infos[0],
+      vk_allocator(VK_OBJECT_TYPE_PIPELINE), &pipeline);
+  chrono::duration<double, milli> elapsed =
+      chrono::steady_clock::now() - start;
 
-  // destroy shader modules immediately after creation, since we don't need it
-  // after we initialize the pipeline
-  for (auto stage : this->shader_stages) {
-    vkDestroyShaderModule(device, stage.module, nullptr);
+  // shader modules are owned by their generation and destroyed with it, not
+  // per pipeline anymore
+  if (result != VK_SUCCESS) {
+    throw runtime_error("unable to create graphics pipeline");
   }
-  return pipelines;
+  report_creation_feedback(creation_feedback, elapsed.count());
+  return pipeline;
 }
@@ -1,21 +1,107 @@
 #pragma once
 
 #include "lib.hpp"
+#include "shader_cache.hpp"
+#include "thread_pool.hpp"
+
+enum class BlendMode : uint8_t { opaque, alpha, additive };
+// position_color_instanced adds binding 1 at instance rate, carrying an
+// `InstanceData` per instance
+enum class VertexLayout : uint8_t { position_color, position_color_instanced };
+
+// everything that distinguishes one graphics pipeline from another, packed
+// so it can be hashed and compared bytewise. shaders are referred to by the
+// ids handed out by `PipelineRegistry::shader_id`.
+struct PipelineKey {
+  uint16_t vertex_shader = 0;
+  uint16_t fragment_shader = 0;
+  uint8_t topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  uint8_t polygon_mode = VK_POLYGON_MODE_FILL;
+  uint8_t cull_mode = VK_CULL_MODE_BACK_BIT;
+  uint8_t front_face = VK_FRONT_FACE_CLOCKWISE;
+  uint8_t depth_test = VK_TRUE;
+  uint8_t depth_write = VK_TRUE;
+  uint8_t depth_compare = VK_COMPARE_OP_LESS_OR_EQUAL;
+  BlendMode blend = BlendMode::opaque;
+  VertexLayout vertex_layout = VertexLayout::position_color;
+  // cull mode, front face, depth state and topology are set while
+  // recording instead of being baked in
+  uint8_t extended_dynamic_state = VK_FALSE;
+  // explicit padding, so no indeterminate bytes end up in the hash
+  uint8_t reserved[2] = {};
+  VkFormat color_format = VK_FORMAT_UNDEFINED;
+  VkFormat depth_format = VK_FORMAT_UNDEFINED;
+
+  bool operator==(const PipelineKey& other) const {
+    return memcmp(this, &other, sizeof(PipelineKey)) == 0;
+  }
+
+  // the same key with every dynamic field reset, so keys that only differ
+  // in dynamic state collapse into one pipeline. topology is only dynamic
+  // within its class (points, lines, triangles, patches)
+  PipelineKey with_extended_dynamic_state() const;
+};
+static_assert(sizeof(PipelineKey) == 24, "PipelineKey must stay unpadded");
+
+// push constants of the shared pipeline layout, read by the vertex stage.
+// a draw's data is `draw_data[first_draw + gl_DrawID]`, gl_DrawID being 0
+// for anything but multi-draw indirect
+struct DrawConstants {
+  VkDeviceAddress draw_data = 0;
+  u32 first_draw = 0;
+  u32 reserved = 0;
+};
+
+struct PipelineKeyHash {
+  size_t operator()(const PipelineKey& key) const;
+};
+
+// one generation of shader modules, shared by every pipeline built from it.
+// the modules are destroyed with the last reference, so a hot reload can
+// start a new generation while builds from the old one are still running.
+struct ShaderModules {
+  VkDevice device = VK_NULL_HANDLE;
+  mutex modules_mutex;
+  unordered_map<string, shared_future<optional<VkShaderModule>>> modules;
+
+  ~ShaderModules();
+};
 
 struct Pipeline {
  public:
-  vector<VkPipelineShaderStageCreateInfo> shader_stages;
-  vector<VkDynamicState> dynamic_states;
-  VkPipelineDynamicStateCreateInfo dynamic_state;
-  VkPipelineVertexInputStateCreateInfo vertex_input_info;
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly;
-  VkPipelineLayout pipelineLayout;
-  DeletionStack deletion_stack;
-  vector<VkVertexInputBindingDescription> vertex_binding_descriptions;
-  vector<VkVertexInputAttributeDescription> vertex_attribute_descriptions;
+  // create infos for a single pipeline build. kept out of `Pipeline` itself
+  // so several builds can run at once
+  struct BuildState {
+    vector<VkPipelineShaderStageCreateInfo> shader_stages;
+    vector<VkDynamicState> dynamic_states;
+    VkPipelineDynamicStateCreateInfo dynamic_state;
+    VkPipelineVertexInputStateCreateInfo vertex_input_info;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+    vector<VkVertexInputBindingDescription> vertex_binding_descriptions;
+    vector<VkVertexInputAttributeDescription> vertex_attribute_descriptions;
+  };
+
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+  // set by hot reload, so edits to shaders/ win over the embedded spirv
+  atomic<bool> prefer_shader_sources = false;
+  DeletionQueue deletion_queue;
+#ifdef RUNTIME_SHADER_COMPILER
+  ShaderCache shader_cache;
+#endif
+  mutex shader_modules_mutex;
+  shared_ptr<ShaderModules> shader_modules;
 
   path get_current_working_dir();
   optional<string> read_to_string(path p);
+  optional<VkShaderModule> create_shader_module(const u32* words,
+                                               size_t word_count,
+                                               const string& shader_name,
+                                               VkDevice device);
+  // prefers spirv embedded at build time, falls back to compiling the glsl
+  // in shaders/ when the runtime compiler is built in
+  optional<VkShaderModule> get_compiled_shader_module(string shader_name,
+                                                      VkDevice device);
+#ifdef RUNTIME_SHADER_COMPILER
   // function basically copied from
   // https://github.com/google/shaderc/blob/main/examples/online-compile/main.cc
   optional<vector<u32>> get_spirv_from_glsl(const std::string& source_code,
@@ -23,19 +109,43 @@ struct Pipeline {
                                             const std::string& source_path,
                                             bool optimize = false);
 
-  optional<VkShaderModule> get_compiled_shader_module(
+  optional<VkShaderModule> compile_shader_module(
       string shader_name,
       shaderc_shader_kind shader_kind,
       VkDevice device);
+#endif
+
+  // shader cache, pipeline layout and the first shader module generation
+  void init(VkDevice device);
+  shared_ptr<ShaderModules> current_shader_modules();
+  // drops the current generation, the next build recompiles everything
+  void invalidate_shader_modules(VkDevice device);
+  // compiled once per generation, concurrent callers wait for the first one
+  optional<VkShaderModule> get_shader_module(ShaderModules& modules,
+                                             const string& shader_name);
+  // kicks off compilation of the given shaders on the worker pool, so later
+  // builds find them ready
+  void compile_shader_stages(const vector<string>& shader_names,
+                             ThreadPool& workers);
 
-  void create_shader_stages(VkDevice device);
+  void create_shader_stages(BuildState& state,
+                            ShaderModules& modules,
+                            const string& vertex_shader,
+                            const string& fragment_shader);
 
-  void create_dynamic_state();
+  void create_dynamic_state(BuildState& state, const PipelineKey& key);
 
-  void create_vertex_input_info();
+  void create_vertex_input_info(BuildState& state, const PipelineKey& key);
 
-  void create_input_assembly();
-  vector<VkPipeline> create(VkDevice& device,
-                            SwapchainDimensions& swapchain_dimensions,
-                            VkRenderPass& render_pass);
-};
\ No newline at end of file
+  void create_input_assembly(BuildState& state, const PipelineKey& key);
+  void report_creation_feedback(const VkPipelineCreationFeedback& feedback,
+                                double elapsed_ms);
+  // thread safe, called from worker threads by the pipeline registry.
+  // a null `render_pass` builds for dynamic rendering
+  VkPipeline create(VkDevice device,
+                    const PipelineKey& key,
+                    const string& vertex_shader,
+                    const string& fragment_shader,
+                    VkRenderPass render_pass,
+                    VkPipelineCache pipeline_cache);
+};
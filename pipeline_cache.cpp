@@ -0,0 +1,164 @@
+#include "pipeline_cache.hpp"
+
+#include "host_allocator.hpp"
+
+// returns the reason the blob has to be dropped, if any
+optional<string> validate_pipeline_cache_header(
+    const vector<char>& data,
+    const VkPhysicalDeviceProperties& properties) {
+  VkPipelineCacheHeaderVersionOne header;
+  if (data.size() < sizeof(header)) {
+    return "file is smaller than the cache header";
+  }
+  memcpy(&header, data.data(), sizeof(header));
+
+  if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+      header.headerSize < sizeof(header)) {
+    return "unknown header version";
+  }
+  if (header.vendorID != properties.vendorID) {
+    return fmt::format("vendor id {:#x} != {:#x}", header.vendorID,
+                       properties.vendorID);
+  }
+  if (header.deviceID != properties.deviceID) {
+    return fmt::format("device id {:#x} != {:#x}", header.deviceID,
+                       properties.deviceID);
+  }
+  // changes with every driver update
+  if (memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+             VK_UUID_SIZE) != 0) {
+    return "pipeline cache uuid changed, driver was probably updated";
+  }
+  return {};
+}
+
+void PipelineCache::create(VkDevice device,
+                           VkPhysicalDevice physical_device,
+                           path file) {
+  this->file = file;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+  auto start = chrono::steady_clock::now();
+  vector<char> data;
+  {
+    ifstream in(file, ios::in | ios::binary);
+    if (in.is_open()) {
+      error_code ec;
+      auto size = file_size(file, ec);
+      if (!ec) {
+        data.resize(size);
+        in.read(data.data(), data.size());
+      }
+    }
+  }
+
+  if (!data.empty()) {
+    optional<string> problem =
+        validate_pipeline_cache_header(data, properties);
+    if (problem.has_value()) {
+      println("dropping stale pipeline cache {}: {}", file.string(),
+              problem.value());
+      data.clear();
+    }
+  }
+
+  VkPipelineCacheCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+      .initialDataSize = data.size(),
+      .pInitialData = data.empty() ? nullptr : data.data(),
+  };
+  VkResult result = vkCreatePipelineCache(
+      device, &create_info, vk_allocator(VK_OBJECT_TYPE_PIPELINE_CACHE),
+      &cache);
+  if (result != VK_SUCCESS && !data.empty()) {
+    // the header looked fine but the driver still refused the payload
+    println("driver rejected pipeline cache {}, starting empty",
+            file.string());
+    data.clear();
+    create_info.initialDataSize = 0;
+    create_info.pInitialData = nullptr;
+    result = vkCreatePipelineCache(
+        device, &create_info, vk_allocator(VK_OBJECT_TYPE_PIPELINE_CACHE),
+        &cache);
+  }
+  VK_CHECK(result, "failed to create pipeline cache");
+
+  loaded_from_disk = !data.empty();
+  chrono::duration<double, milli> elapsed =
+      chrono::steady_clock::now() - start;
+  if (loaded_from_disk) {
+    println("loaded pipeline cache ({} bytes) in {:.2f}ms", data.size(),
+            elapsed.count());
+  }
+}
+
+VkPipelineCache PipelineCache::create_child(VkDevice device) {
+  VkPipelineCacheCreateInfo create_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+  };
+  VkPipelineCache child;
+  VK_CHECK(vkCreatePipelineCache(device, &create_info,
+                                 vk_allocator(VK_OBJECT_TYPE_PIPELINE_CACHE),
+                                 &child),
+           "failed to create pipeline cache");
+  children.push_back(child);
+  return child;
+}
+
+void PipelineCache::merge_children(VkDevice device) {
+  if (children.empty()) {
+    return;
+  }
+  VK_CHECK(vkMergePipelineCaches(device, cache,
+                                 static_cast<u32>(children.size()),
+                                 children.data()),
+           "failed to merge pipeline caches");
+}
+
+void PipelineCache::save(VkDevice device) {
+  if (cache == VK_NULL_HANDLE || file.empty()) {
+    return;
+  }
+  merge_children(device);
+
+  size_t size = 0;
+  VK_CHECK(vkGetPipelineCacheData(device, cache, &size, nullptr),
+           "failed to query pipeline cache size");
+  vector<char> data(size);
+  VK_CHECK_CONDITIONAL(
+      vkGetPipelineCacheData(device, cache, &size, data.data()),
+      "failed to read pipeline cache", {VK_INCOMPLETE});
+  data.resize(size);
+
+  error_code ec;
+  create_directories(file.parent_path(), ec);
+  // same write-then-rename dance as the shader cache
+  path tmp = file;
+  tmp += ".tmp";
+  {
+    ofstream out(tmp, ios::out | ios::binary | ios::trunc);
+    if (!out.is_open()) {
+      println("failed to open {} for writing", tmp.string());
+      return;
+    }
+    out.write(data.data(), data.size());
+  }
+  filesystem::rename(tmp, file, ec);
+  if (ec) {
+    println("failed to write pipeline cache {}: {}", file.string(),
+            ec.message());
+  }
+}
+
+void PipelineCache::destroy(VkDevice device) {
+  for (auto child : children) {
+    vkDestroyPipelineCache(device, child,
+                           vk_allocator(VK_OBJECT_TYPE_PIPELINE_CACHE));
+  }
+  children.clear();
+  vkDestroyPipelineCache(device, cache,
+                         vk_allocator(VK_OBJECT_TYPE_PIPELINE_CACHE));
+  cache = VK_NULL_HANDLE;
+}
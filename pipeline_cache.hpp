@@ -0,0 +1,24 @@
+#pragma once
+
+#include "lib.hpp"
+
+// driver pipeline cache that survives restarts.
+// the blob is validated against the current physical device before use,
+// since drivers are free to crash or silently miscompile on foreign data.
+struct PipelineCache {
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  // extra caches that get folded into `cache` before it is written out
+  vector<VkPipelineCache> children;
+  path file;
+  bool loaded_from_disk = false;
+
+  void create(VkDevice device, VkPhysicalDevice physical_device, path file);
+  VkPipelineCache create_child(VkDevice device);
+  void merge_children(VkDevice device);
+  void save(VkDevice device);
+  void destroy(VkDevice device);
+};
+
+optional<string> validate_pipeline_cache_header(
+    const vector<char>& data,
+    const VkPhysicalDeviceProperties& properties);
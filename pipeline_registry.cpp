@@ -0,0 +1,210 @@
+#include "pipeline_registry.hpp"
+
+#include "host_allocator.hpp"
+
+void PipelineRegistry::init(VkDevice device,
+                            Pipeline& builder,
+                            ThreadPool& workers,
+                            VkRenderPass render_pass,
+                            VkPipelineCache pipeline_cache,
+                            bool extended_dynamic_state) {
+  this->device = device;
+  this->builder = &builder;
+  this->workers = &workers;
+  this->render_pass = render_pass;
+  this->pipeline_cache = pipeline_cache;
+  this->extended_dynamic_state = extended_dynamic_state;
+}
+
+uint16_t PipelineRegistry::shader_id(const string& shader_name) {
+  lock_guard lock(registry_mutex);
+  for (size_t i = 0; i < shader_names.size(); i++) {
+    if (shader_names[i] == shader_name) {
+      return static_cast<uint16_t>(i);
+    }
+  }
+  shader_names.push_back(shader_name);
+  return static_cast<uint16_t>(shader_names.size() - 1);
+}
+
+PipelineHandle PipelineRegistry::request(const PipelineKey& requested_key) {
+  PipelineKey key = extended_dynamic_state
+                        ? requested_key.with_extended_dynamic_state()
+                        : requested_key;
+  PipelineHandle handle;
+  {
+    lock_guard lock(registry_mutex);
+    auto it = handles.find(key);
+    if (it != handles.end()) {
+      return it->second;
+    }
+    handle = static_cast<PipelineHandle>(entries.size());
+    entries.push_back({.key = key, .requested_generation = 1});
+    handles[key] = handle;
+    builds_in_flight++;
+  }
+  workers->submit([this, handle, key]() { this->build(handle, key, 1); });
+  return handle;
+}
+
+void PipelineRegistry::build(PipelineHandle handle,
+                             const PipelineKey& key,
+                             u32 generation) {
+  string vertex_shader;
+  string fragment_shader;
+  {
+    lock_guard lock(registry_mutex);
+    vertex_shader = shader_names[key.vertex_shader];
+    fragment_shader = shader_names[key.fragment_shader];
+  }
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  try {
+    pipeline = builder->create(device, key, vertex_shader, fragment_shader,
+                               render_pass, pipeline_cache);
+  } catch (const exception& e) {
+    // draws keep using the fallback (or the previous version)
+    println("failed to build pipeline {} ({} + {}): {}", handle,
+            vertex_shader, fragment_shader, e.what());
+  }
+
+  {
+    lock_guard lock(registry_mutex);
+    built.push_back(
+        {.handle = handle, .generation = generation, .pipeline = pipeline});
+    builds_in_flight--;
+  }
+  built_available.notify_all();
+}
+
+void PipelineRegistry::wait(PipelineHandle handle) {
+  unique_lock lock(registry_mutex);
+  while (true) {
+    const Entry& entry = entries[handle];
+    if (entry.pipeline != VK_NULL_HANDLE) {
+      return;
+    }
+    // landed, the next `commit` swaps it in. retiring is left to that
+    // commit, which knows what frames in flight may still be using
+    for (auto& b : built) {
+      if (b.handle == handle && b.generation == entry.requested_generation) {
+        if (b.pipeline == VK_NULL_HANDLE) {
+          throw runtime_error(
+              fmt::format("unable to build pipeline {}", handle));
+        }
+        return;
+      }
+    }
+    if (entry.applied_generation == entry.requested_generation) {
+      throw runtime_error(fmt::format("unable to build pipeline {}", handle));
+    }
+    built_available.wait(lock);
+  }
+}
+
+VkPipeline PipelineRegistry::get(PipelineHandle handle) const {
+  // requested after the last commit, so it can't be built yet either
+  if (handle >= bound.size()) {
+    return fallback < bound.size() ? bound[fallback] : VK_NULL_HANDLE;
+  }
+  return bound[handle];
+}
+
+bool PipelineRegistry::commit(u64 last_submitted, u64 completed) {
+  lock_guard lock(registry_mutex);
+
+  erase_if(retired, [&](RetiredPipeline& r) {
+    if (r.last_used_value > completed) {
+      return false;
+    }
+    vkDestroyPipeline(device, r.pipeline,
+                      vk_allocator(VK_OBJECT_TYPE_PIPELINE));
+    return true;
+  });
+
+  bool changed = false;
+  for (auto& b : built) {
+    Entry& entry = entries[b.handle];
+    if (b.generation < entry.applied_generation) {
+      // a newer build already landed, this one was never bound
+      if (b.pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, b.pipeline,
+                          vk_allocator(VK_OBJECT_TYPE_PIPELINE));
+      }
+      continue;
+    }
+    entry.applied_generation = b.generation;
+    if (b.pipeline == VK_NULL_HANDLE) {
+      continue;
+    }
+    if (entry.pipeline != VK_NULL_HANDLE) {
+      // nothing recorded from here on binds it
+      retired.push_back(
+          {.pipeline = entry.pipeline, .last_used_value = last_submitted});
+    }
+    entry.pipeline = b.pipeline;
+    changed = true;
+  }
+  built.clear();
+
+  // what `get` hands out until the next commit, with the fallback resolved
+  if (changed || bound.size() != entries.size()) {
+    VkPipeline fallback_pipeline =
+        fallback < entries.size() ? entries[fallback].pipeline
+                                  : VK_NULL_HANDLE;
+    bound.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+      bound[i] = entries[i].pipeline != VK_NULL_HANDLE ? entries[i].pipeline
+                                                        : fallback_pipeline;
+    }
+  }
+  return changed;
+}
+
+void PipelineRegistry::rebuild_all() {
+  builder->invalidate_shader_modules(device);
+
+  vector<tuple<PipelineHandle, PipelineKey, u32>> jobs;
+  {
+    lock_guard lock(registry_mutex);
+    for (size_t i = 0; i < entries.size(); i++) {
+      Entry& entry = entries[i];
+      entry.requested_generation++;
+      jobs.push_back({static_cast<PipelineHandle>(i), entry.key,
+                      entry.requested_generation});
+    }
+    builds_in_flight += static_cast<u32>(jobs.size());
+  }
+  for (auto& [handle, key, generation] : jobs) {
+    workers->submit([this, handle, key, generation]() {
+      this->build(handle, key, generation);
+    });
+  }
+}
+
+void PipelineRegistry::destroy() {
+  unique_lock lock(registry_mutex);
+  built_available.wait(lock, [this]() { return builds_in_flight == 0; });
+
+  for (auto& b : built) {
+    if (b.pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(device, b.pipeline,
+                        vk_allocator(VK_OBJECT_TYPE_PIPELINE));
+    }
+  }
+  for (auto& entry : entries) {
+    if (entry.pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(device, entry.pipeline,
+                        vk_allocator(VK_OBJECT_TYPE_PIPELINE));
+    }
+  }
+  for (auto& r : retired) {
+    vkDestroyPipeline(device, r.pipeline,
+                      vk_allocator(VK_OBJECT_TYPE_PIPELINE));
+  }
+  built.clear();
+  entries.clear();
+  bound.clear();
+  handles.clear();
+  retired.clear();
+}
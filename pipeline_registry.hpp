@@ -0,0 +1,88 @@
+#pragma once
+
+#include "lib.hpp"
+#include "pipeline.hpp"
+#include "thread_pool.hpp"
+
+// stable index into the registry, valid for its whole lifetime
+using PipelineHandle = u32;
+
+// a pipeline that was swapped out, destroyed once no frame in flight can
+// still be using it
+struct RetiredPipeline {
+  VkPipeline pipeline;
+  // timeline value of the last submission that could have bound it
+  u64 last_used_value;
+};
+
+// owns every graphics pipeline. identical requests are deduplicated by
+// their `PipelineKey`, missing pipelines are built on the worker pool, and
+// until a build lands `get` hands out the fallback pipeline, so the render
+// loop never waits on the driver compiler.
+struct PipelineRegistry {
+  struct Entry {
+    PipelineKey key;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    // bumped for every build request, so a slow stale build can't overwrite
+    // a newer one
+    u32 requested_generation = 0;
+    u32 applied_generation = 0;
+  };
+
+  // a finished build waiting to be swapped in at the next frame boundary
+  struct Built {
+    PipelineHandle handle;
+    u32 generation;
+    VkPipeline pipeline;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+  Pipeline* builder = nullptr;
+  ThreadPool* workers = nullptr;
+  // requested keys are collapsed to their dynamic state variant
+  bool extended_dynamic_state = false;
+
+  // only written by `commit`, between frames, and read by `get` without a
+  // lock, also from the threads recording a frame in parallel
+  vector<VkPipeline> bound;
+  // guards everything below
+  mutex registry_mutex;
+  condition_variable built_available;
+  // deque so references stay valid while entries are appended
+  deque<Entry> entries;
+  unordered_map<PipelineKey, PipelineHandle, PipelineKeyHash> handles;
+  vector<string> shader_names;
+  vector<Built> built;
+  vector<RetiredPipeline> retired;
+  u32 builds_in_flight = 0;
+  PipelineHandle fallback = 0;
+
+  void init(VkDevice device,
+            Pipeline& builder,
+            ThreadPool& workers,
+            VkRenderPass render_pass,
+            VkPipelineCache pipeline_cache,
+            bool extended_dynamic_state);
+  uint16_t shader_id(const string& shader_name);
+  PipelineHandle request(const PipelineKey& requested_key);
+  // blocks until the pipeline behind `handle` was built, it's bound from
+  // the next `commit` on. startup only
+  void wait(PipelineHandle handle);
+  // the real pipeline if it was ready at the last `commit`, the fallback
+  // otherwise. thread safe while no `commit` runs
+  VkPipeline get(PipelineHandle handle) const;
+  // frame boundary: swaps in finished builds and destroys retired pipelines
+  // that no frame in flight can be using. `last_submitted` is the timeline
+  // value of the latest submission, `completed` the value the gpu has
+  // reached. returns whether any pipeline changed
+  bool commit(u64 last_submitted, u64 completed);
+  // rebuilds every pipeline from a fresh shader module generation, used by
+  // hot reload. the old pipelines stay in use until the new ones land
+  void rebuild_all();
+  void destroy();
+
+ private:
+  void build(PipelineHandle handle, const PipelineKey& key, u32 generation);
+};
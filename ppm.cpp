@@ -0,0 +1,27 @@
+#include "ppm.hpp"
+
+void write_ppm(const path& file,
+               const uint8_t* bgra,
+               VkExtent2D extent,
+               size_t row_pitch) {
+  ofstream out(file, ios::out | ios::binary | ios::trunc);
+  if (!out.is_open()) {
+    throw runtime_error(
+        fmt::format("failed to open {} for writing", file.string()));
+  }
+  out << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+
+  vector<uint8_t> row(static_cast<size_t>(extent.width) * 3);
+  for (u32 y = 0; y < extent.height; y++) {
+    const uint8_t* pixel = bgra + y * row_pitch;
+    for (u32 x = 0; x < extent.width; x++, pixel += 4) {
+      row[x * 3 + 0] = pixel[2];
+      row[x * 3 + 1] = pixel[1];
+      row[x * 3 + 2] = pixel[0];
+    }
+    out.write(reinterpret_cast<const char*>(row.data()), row.size());
+  }
+  if (!out) {
+    throw runtime_error(fmt::format("failed to write {}", file.string()));
+  }
+}
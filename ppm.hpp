@@ -0,0 +1,11 @@
+#pragma once
+
+#include "lib.hpp"
+
+// binary (P6) ppm from 8 bit bgra pixels, the layout of
+// VK_FORMAT_B8G8R8A8_UNORM. `row_pitch` is in bytes. throws if the file
+// can't be written
+void write_ppm(const path& file,
+               const uint8_t* bgra,
+               VkExtent2D extent,
+               size_t row_pitch);
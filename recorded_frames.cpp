@@ -0,0 +1,70 @@
+#include "recorded_frames.hpp"
+
+#include "host_allocator.hpp"
+
+void RecordedFrames::init(VkDevice device,
+                          u32 queue_family_index,
+                          u32 frame_count) {
+  this->device = device;
+  this->frame_count = frame_count;
+  VkCommandPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = queue_family_index,
+  };
+  VK_CHECK(vkCreateCommandPool(device, &pool_info,
+                               vk_allocator(VK_OBJECT_TYPE_COMMAND_POOL),
+                               &pool),
+           "unable to create recorded frame command pool");
+}
+
+void RecordedFrames::destroy() {
+  // frees the command buffers as well
+  vkDestroyCommandPool(device, pool,
+                       vk_allocator(VK_OBJECT_TYPE_COMMAND_POOL));
+  entries.clear();
+}
+
+void RecordedFrames::invalidate() {
+  generation++;
+  invalidations++;
+}
+
+RecordedFrames::Entry& RecordedFrames::entry(u32 slot, u32 image) {
+  size_t index = static_cast<size_t>(image) * frame_count + slot;
+  if (index >= entries.size()) {
+    // never shrinks, a buffer could still be pending from its slot
+    entries.resize(index + 1);
+  }
+  Entry& entry = entries[index];
+  if (entry.command_buffer == VK_NULL_HANDLE) {
+    VkCommandBufferAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info,
+                                      &entry.command_buffer),
+             "unable to allocate recorded frame command buffer");
+  }
+  return entry;
+}
+
+bool RecordedFrames::is_current(const Entry& entry) const {
+  return entry.generation == generation;
+}
+
+void RecordedFrames::recorded(Entry& entry,
+                              const vector<const char*>& gpu_spans,
+                              VkDeviceSize frame_data_offset) {
+  entry.generation = generation;
+  entry.gpu_spans = gpu_spans;
+  entry.frame_data_offset = frame_data_offset;
+  records++;
+}
+
+void RecordedFrames::print_stats() const {
+  println("recorded frames: {} recorded, {} replayed, {} invalidations",
+          records, replays, invalidations);
+}
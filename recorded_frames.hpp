@@ -0,0 +1,51 @@
+#pragma once
+
+#include "lib.hpp"
+
+// frame command buffers kept around and submitted again while nothing they
+// record has changed, so a static scene costs acquire + submit + present.
+// there is one per frame slot and swapchain image. buffer i only ever
+// belongs to slot i % frame_count, so waiting for a slot also means its
+// cached buffers are no longer pending and may be submitted or re-recorded.
+// anything that changes what a frame records (the scene, pipelines, the
+// swapchain) calls `invalidate`, after which each buffer is re-recorded the
+// next time it comes up.
+struct RecordedFrames {
+  struct Entry {
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    // `generation` when it was recorded, 0 before the first recording
+    u64 generation = 0;
+    // the gpu timer spans it writes
+    vector<const char*> gpu_spans;
+    // where the frame allocator data it reads was, it can only be replayed
+    // while that is where the current frame's is
+    VkDeviceSize frame_data_offset = 0;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  // buffers are re-recorded one by one, so they can be reset individually
+  VkCommandPool pool = VK_NULL_HANDLE;
+  u32 frame_count = 0;
+  // index image * frame_count + slot, grows with the swapchain image count
+  vector<Entry> entries;
+  u64 generation = 1;
+
+  u64 records = 0;
+  u64 replays = 0;
+  u64 invalidations = 0;
+
+  void init(VkDevice device, u32 queue_family_index, u32 frame_count);
+  void destroy();
+
+  // raises the dirty flag for every cached buffer
+  void invalidate();
+  // the entry for `image` in frame slot `slot`, with a command buffer
+  Entry& entry(u32 slot, u32 image);
+  bool is_current(const Entry& entry) const;
+  // after recording `entry`'s command buffer
+  void recorded(Entry& entry,
+                const vector<const char*>& gpu_spans,
+                VkDeviceSize frame_data_offset);
+
+  void print_stats() const;
+};
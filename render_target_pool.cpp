@@ -0,0 +1,153 @@
+#include "render_target_pool.hpp"
+
+#include "host_allocator.hpp"
+
+static u32 round_up(u32 value, u32 multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+static u64 area(VkExtent2D extent) {
+  return static_cast<u64>(extent.width) * extent.height;
+}
+
+void RenderTargetPool::init(VkDevice device,
+                            VmaAllocator allocator,
+                            double idle_seconds) {
+  this->device = device;
+  this->allocator = allocator;
+  this->idle_seconds = idle_seconds;
+
+  const VkPhysicalDeviceMemoryProperties* memory_properties;
+  vmaGetMemoryProperties(allocator, &memory_properties);
+  for (u32 i = 0; i < memory_properties->memoryTypeCount; i++) {
+    if (memory_properties->memoryTypes[i].propertyFlags &
+        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+      lazily_allocated_memory = true;
+    }
+  }
+}
+
+void RenderTargetPool::destroy() {
+  for (auto& target : targets) {
+    destroy_target(*target);
+  }
+  targets.clear();
+}
+
+RenderTarget* RenderTargetPool::acquire(const RenderTargetDesc& desc,
+                                        VkExtent2D extent) {
+  RenderTarget* best = nullptr;
+  for (auto& target : targets) {
+    if (target->in_use || target->desc.format != desc.format ||
+        target->desc.usage != desc.usage ||
+        target->desc.aspect != desc.aspect ||
+        target->desc.transient != desc.transient ||
+        target->extent.width < extent.width ||
+        target->extent.height < extent.height) {
+      continue;
+    }
+    if (best == nullptr || area(target->extent) < area(best->extent)) {
+      best = target.get();
+    }
+  }
+
+  // after shrinking a lot, a fresh small target beats holding on to a huge
+  // one. the big one is reclaimed once it has been idle
+  VkExtent2D rounded = {.width = round_up(extent.width, granularity),
+                        .height = round_up(extent.height, granularity)};
+  if (best == nullptr || area(best->extent) > 4 * area(rounded)) {
+    best = create(desc, rounded);
+  }
+  best->in_use = true;
+  return best;
+}
+
+void RenderTargetPool::release(RenderTarget* target, u64 last_used_value) {
+  target->in_use = false;
+  target->released_value = last_used_value;
+  target->released_at = chrono::steady_clock::now();
+}
+
+void RenderTargetPool::collect(u64 completed) {
+  auto now = chrono::steady_clock::now();
+  erase_if(targets, [&](unique_ptr<RenderTarget>& target) {
+    if (target->in_use || target->released_value > completed ||
+        now - target->released_at < chrono::duration<double>(idle_seconds)) {
+      return false;
+    }
+    destroy_target(*target);
+    return true;
+  });
+}
+
+RenderTarget* RenderTargetPool::create(const RenderTargetDesc& desc,
+                                       VkExtent2D extent) {
+  auto target = make_unique<RenderTarget>();
+  target->desc = desc;
+  target->extent = extent;
+  target->lazily_allocated = desc.transient && lazily_allocated_memory;
+
+  VkImageCreateInfo image_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = desc.format,
+      .extent = {.width = extent.width, .height = extent.height, .depth = 1},
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = desc.usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+  };
+  VmaAllocationCreateInfo alloc_info = {
+      // resizes are rare enough that a block of their own is worth it
+      .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+      .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+  };
+  if (target->lazily_allocated) {
+    // backed by tile memory only, never by actual vram
+    VkImageCreateInfo lazy_image_info = image_info;
+    lazy_image_info.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    VmaAllocationCreateInfo lazy_alloc_info = {
+        .usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED,
+    };
+    // the lazily allocated type may not be one the image's memoryTypeBits
+    // allow, or be out of memory. either way it gets the dedicated
+    // allocation instead
+    target->lazily_allocated =
+        vmaCreateImage(allocator, &lazy_image_info, &lazy_alloc_info,
+                       &target->image, &target->allocation,
+                       nullptr) == VK_SUCCESS;
+  }
+  if (!target->lazily_allocated) {
+    VK_CHECK(vmaCreateImage(allocator, &image_info, &alloc_info,
+                            &target->image, &target->allocation, nullptr),
+             "unable to create render target");
+  }
+
+  VkImageViewCreateInfo view_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image = target->image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = desc.format,
+      .subresourceRange = {.aspectMask = desc.aspect,
+                           .baseMipLevel = 0,
+                           .levelCount = 1,
+                           .baseArrayLayer = 0,
+                           .layerCount = 1},
+  };
+  VK_CHECK(vkCreateImageView(device, &view_info,
+                             vk_allocator(VK_OBJECT_TYPE_IMAGE_VIEW),
+                             &target->image_view),
+           "unable to create render target view");
+
+  targets.push_back(std::move(target));
+  return targets.back().get();
+}
+
+void RenderTargetPool::destroy_target(RenderTarget& target) {
+  vkDestroyImageView(device, target.image_view,
+                     vk_allocator(VK_OBJECT_TYPE_IMAGE_VIEW));
+  vmaDestroyImage(allocator, target.image, target.allocation);
+}
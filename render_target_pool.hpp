@@ -0,0 +1,56 @@
+#pragma once
+
+#include "lib.hpp"
+
+struct RenderTargetDesc {
+  VkFormat format;
+  VkImageUsageFlags usage;
+  VkImageAspectFlags aspect;
+  // never read outside the pass that writes it (depth, msaa color), so it
+  // can live in lazily allocated memory on tilers
+  bool transient = false;
+};
+
+struct RenderTarget {
+  RenderTargetDesc desc;
+  // may be larger than what was asked for, render with a smaller area
+  VkExtent2D extent;
+  VkImage image = VK_NULL_HANDLE;
+  VkImageView image_view = VK_NULL_HANDLE;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  bool lazily_allocated = false;
+  bool in_use = false;
+  // timeline value of the last submission that used it
+  u64 released_value = 0;
+  chrono::steady_clock::time_point released_at;
+};
+
+// hands out attachment images at or above the requested extent, so a window
+// being dragged reuses the same few images instead of reallocating on every
+// resize event. released targets are kept around until they have been idle
+// for `idle_seconds`.
+struct RenderTargetPool {
+  VkDevice device = VK_NULL_HANDLE;
+  VmaAllocator allocator = VK_NULL_HANDLE;
+  double idle_seconds = 2;
+  // new targets are rounded up to a multiple of this, so growing a window
+  // a few pixels at a time doesn't allocate every time
+  u32 granularity = 256;
+  bool lazily_allocated_memory = false;
+  vector<unique_ptr<RenderTarget>> targets;
+
+  void init(VkDevice device, VmaAllocator allocator, double idle_seconds);
+  void destroy();
+
+  RenderTarget* acquire(const RenderTargetDesc& desc, VkExtent2D extent);
+  // the caller must not use it in submissions after `last_used_value`
+  void release(RenderTarget* target, u64 last_used_value);
+  // destroys released targets that have been idle for long enough and that
+  // no submission still running can be using. `completed` is the timeline
+  // value the gpu has reached
+  void collect(u64 completed);
+
+ private:
+  RenderTarget* create(const RenderTargetDesc& desc, VkExtent2D extent);
+  void destroy_target(RenderTarget& target);
+};
@@ -0,0 +1,91 @@
+#include "retired_swapchains.hpp"
+
+#include "host_allocator.hpp"
+
+void RetiredSwapchains::init(VkDevice device,
+                             VkQueue queue,
+                             bool present_fences) {
+  this->device = device;
+  this->queue = queue;
+  this->present_fences = present_fences;
+}
+
+void RetiredSwapchains::destroy() {
+  for (auto& p : pending) {
+    VK_CHECK(vkWaitForFences(device, 1, &p.fence, VK_TRUE, UINT64_MAX),
+             "failed to wait for present fence");
+    vkDestroyFence(device, p.fence, vk_allocator(VK_OBJECT_TYPE_FENCE));
+  }
+  pending.clear();
+  for (auto& fence : free_fences) {
+    vkDestroyFence(device, fence, vk_allocator(VK_OBJECT_TYPE_FENCE));
+  }
+  free_fences.clear();
+  release(UINT64_MAX);
+}
+
+void RetiredSwapchains::retire(VkSwapchainKHR swapchain,
+                               vector<VkImageView>&& image_views) {
+  retired.push_back({.swapchain = swapchain,
+                     .image_views = std::move(image_views),
+                     .generation = generation});
+  generation++;
+}
+
+VkFence RetiredSwapchains::present_fence() {
+  if (!present_fences) {
+    return VK_NULL_HANDLE;
+  }
+  VkFence fence;
+  if (free_fences.empty()) {
+    VkFenceCreateInfo fence_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VK_CHECK(vkCreateFence(device, &fence_info,
+                           vk_allocator(VK_OBJECT_TYPE_FENCE), &fence),
+             "unable to create present fence");
+  } else {
+    fence = free_fences.back();
+    free_fences.pop_back();
+  }
+  pending.push_back({.fence = fence, .generation = generation});
+  return fence;
+}
+
+void RetiredSwapchains::presented() {
+  if (!present_fences) {
+    if (!retired.empty()) {
+      // not quite the presentation engine, but the best there is
+      VK_CHECK(vkQueueWaitIdle(queue), "failed to wait for queue");
+      release(UINT64_MAX);
+    }
+    return;
+  }
+  // an out of date present still counts as enqueued and signals its fence.
+  // fences are taken in present order, so every present up to the last one
+  // taken is done
+  u64 completed = 0;
+  while (!pending.empty() &&
+         vkGetFenceStatus(device, pending.front().fence) == VK_SUCCESS) {
+    completed = max(completed, pending.front().generation);
+    VK_CHECK(vkResetFences(device, 1, &pending.front().fence),
+             "failed to reset present fence");
+    free_fences.push_back(pending.front().fence);
+    pending.pop_front();
+  }
+  release(completed);
+}
+
+void RetiredSwapchains::release(u64 generation) {
+  erase_if(retired, [&](Retired& r) {
+    if (r.generation >= generation) {
+      return false;
+    }
+    for (auto& image_view : r.image_views) {
+      vkDestroyImageView(device, image_view,
+                         vk_allocator(VK_OBJECT_TYPE_IMAGE_VIEW));
+    }
+    vkDestroySwapchainKHR(device, r.swapchain,
+                          vk_allocator(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
+    return true;
+  });
+}
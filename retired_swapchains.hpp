@@ -0,0 +1,52 @@
+#pragma once
+
+#include "lib.hpp"
+
+// swapchains replaced by a new one, kept alive until the presentation
+// engine is done with their images. the timeline and the frame fences only
+// cover queue work, a present of an old image can still be pending after
+// every frame that rendered it has finished.
+// with VK_EXT_swapchain_maintenance1 every present signals a fence, and an
+// old swapchain is destroyed once a present on a newer one, and every
+// present before it, has completed. without it, the first present on the
+// new swapchain is followed by a queue idle wait instead.
+struct RetiredSwapchains {
+  struct Retired {
+    VkSwapchainKHR swapchain;
+    vector<VkImageView> image_views;
+    // `generation` while it was the current swapchain
+    u64 generation;
+  };
+
+  struct PresentFence {
+    VkFence fence;
+    // the swapchain generation it presented to
+    u64 generation;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  VkQueue queue = VK_NULL_HANDLE;
+  bool present_fences = false;
+  // bumped for every swapchain that replaces another
+  u64 generation = 0;
+  vector<Retired> retired;
+  // in present order
+  deque<PresentFence> pending;
+  vector<VkFence> free_fences;
+
+  void init(VkDevice device, VkQueue queue, bool present_fences);
+  // waits for every pending present, the device has to be idle
+  void destroy();
+
+  // right after `swapchain` was passed as oldSwapchain to create a new one
+  void retire(VkSwapchainKHR swapchain, vector<VkImageView>&& image_views);
+  // the fence to chain into the next present with
+  // VkSwapchainPresentFenceInfoEXT, VK_NULL_HANDLE without the extension
+  VkFence present_fence();
+  // after every vkQueuePresentKHR, destroys what is no longer presented
+  void presented();
+
+ private:
+  // destroys the swapchains older than `generation`
+  void release(u64 generation);
+};
@@ -0,0 +1,216 @@
+#include "shader_cache.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// bump whenever the layout of a cache entry changes
+const u32 SHADER_CACHE_FORMAT_VERSION = 1;
+const u32 SPIRV_MAGIC = 0x07230203;
+
+// set by cmake from the shaderc library, see CMakeLists.txt
+#ifndef SHADER_COMPILER_BUILD
+#define SHADER_COMPILER_BUILD "unknown"
+#endif
+
+SpirvBlob::SpirvBlob(vector<u32>&& spirv) : owned(std::move(spirv)) {
+  words = owned.data();
+  word_count = owned.size();
+}
+
+SpirvBlob::SpirvBlob(SpirvBlob&& other) noexcept {
+  *this = std::move(other);
+}
+
+SpirvBlob& SpirvBlob::operator=(SpirvBlob&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  release();
+  // moving a vector keeps its heap buffer, so `words` stays valid
+  owned = std::move(other.owned);
+  words = other.words;
+  word_count = other.word_count;
+  mapping = other.mapping;
+  mapping_size = other.mapping_size;
+#ifdef _WIN32
+  mapping_handle = other.mapping_handle;
+  other.mapping_handle = nullptr;
+#endif
+  other.words = nullptr;
+  other.word_count = 0;
+  other.mapping = nullptr;
+  other.mapping_size = 0;
+  return *this;
+}
+
+SpirvBlob::~SpirvBlob() {
+  release();
+}
+
+void SpirvBlob::release() {
+  if (mapping != nullptr) {
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+    CloseHandle(mapping_handle);
+    mapping_handle = nullptr;
+#else
+    munmap(mapping, mapping_size);
+#endif
+    mapping = nullptr;
+    mapping_size = 0;
+  }
+  owned.clear();
+  words = nullptr;
+  word_count = 0;
+}
+
+#ifdef RUNTIME_SHADER_COMPILER
+void ShaderCache::init(path directory) {
+  this->directory = directory;
+  error_code ec;
+  create_directories(directory, ec);
+  if (ec) {
+    println("unable to create shader cache directory {}: {}",
+            directory.string(), ec.message());
+  }
+}
+
+// 64 bit fnv-1a, good enough to address a handful of shaders
+static void fnv1a(u64& hash, const void* data, size_t size) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+}
+
+u64 ShaderCache::key(const string& source_code,
+                     const path& source_path,
+                     shaderc_shader_kind kind,
+                     bool optimize) const {
+  unsigned int spirv_version = 0;
+  unsigned int spirv_revision = 0;
+  shaderc_get_spv_version(&spirv_version, &spirv_revision);
+
+  u64 hash = 0xcbf29ce484222325ull;
+  fnv1a(hash, &SHADER_CACHE_FORMAT_VERSION,
+        sizeof(SHADER_CACHE_FORMAT_VERSION));
+  string compiler_build = SHADER_COMPILER_BUILD;
+  fnv1a(hash, compiler_build.data(), compiler_build.size());
+  fnv1a(hash, &spirv_version, sizeof(spirv_version));
+  fnv1a(hash, &spirv_revision, sizeof(spirv_revision));
+  fnv1a(hash, &kind, sizeof(kind));
+  fnv1a(hash, &optimize, sizeof(optimize));
+  // includes are resolved relative to it
+  string source_name = source_path.string();
+  fnv1a(hash, source_name.data(), source_name.size());
+  fnv1a(hash, source_code.data(), source_code.size());
+  return hash;
+}
+
+path ShaderCache::entry_path(u64 key) const {
+  return directory / fmt::format("{:016x}.spv", key);
+}
+
+optional<SpirvBlob> ShaderCache::load(u64 key) const {
+  if (directory.empty()) {
+    return {};
+  }
+  path p = entry_path(key);
+
+  SpirvBlob blob;
+#ifdef _WIN32
+  HANDLE file = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return {};
+  }
+  LARGE_INTEGER file_size_info;
+  if (!GetFileSizeEx(file, &file_size_info) ||
+      file_size_info.QuadPart == 0) {
+    CloseHandle(file);
+    return {};
+  }
+  size_t size = static_cast<size_t>(file_size_info.QuadPart);
+  HANDLE mapping_handle =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  // the mapping object keeps the file alive on its own
+  CloseHandle(file);
+  if (mapping_handle == nullptr) {
+    return {};
+  }
+  void* mapping = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+  if (mapping == nullptr) {
+    CloseHandle(mapping_handle);
+    return {};
+  }
+  blob.mapping_handle = mapping_handle;
+#else
+  int fd = open(p.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return {};
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return {};
+  }
+  size_t size = static_cast<size_t>(file_stat.st_size);
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return {};
+  }
+#endif
+  blob.mapping = mapping;
+  blob.mapping_size = size;
+  blob.words = static_cast<const u32*>(mapping);
+  blob.word_count = size / sizeof(u32);
+
+  // a truncated or foreign file is treated as a miss and overwritten later
+  if (size % sizeof(u32) != 0 || blob.words[0] != SPIRV_MAGIC) {
+    println("ignoring corrupt shader cache entry {}", p.string());
+    return {};
+  }
+  return blob;
+}
+
+void ShaderCache::store(u64 key, const vector<u32>& spirv) const {
+  if (directory.empty()) {
+    return;
+  }
+  path p = entry_path(key);
+  // write to a temporary file first and rename it into place, so a crash or
+  // a concurrent reader never observes a half written entry
+  path tmp = p;
+  tmp += fmt::format(".{}.tmp", hash<thread::id>{}(this_thread::get_id()));
+
+  {
+    ofstream out(tmp, ios::out | ios::binary | ios::trunc);
+    if (!out.is_open()) {
+      println("failed to open shader cache entry {} for writing",
+              tmp.string());
+      return;
+    }
+    out.write(reinterpret_cast<const char*>(spirv.data()),
+              spirv.size() * sizeof(u32));
+  }
+
+  error_code ec;
+  filesystem::rename(tmp, p, ec);
+  if (ec) {
+    println("failed to write shader cache entry {}: {}", p.string(),
+            ec.message());
+    filesystem::remove(tmp, ec);
+  }
+}
+#endif
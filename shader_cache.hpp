@@ -0,0 +1,47 @@
+#pragma once
+
+#include "lib.hpp"
+
+// spirv words for a single shader, either memory mapped straight from the
+// on-disk cache or owned after a fresh compile
+struct SpirvBlob {
+  const u32* words = nullptr;
+  size_t word_count = 0;
+  vector<u32> owned;
+  void* mapping = nullptr;
+  size_t mapping_size = 0;
+#ifdef _WIN32
+  void* mapping_handle = nullptr;
+#endif
+
+  SpirvBlob() = default;
+  explicit SpirvBlob(vector<u32>&& spirv);
+  SpirvBlob(SpirvBlob&& other) noexcept;
+  SpirvBlob& operator=(SpirvBlob&& other) noexcept;
+  SpirvBlob(const SpirvBlob&) = delete;
+  SpirvBlob& operator=(const SpirvBlob&) = delete;
+  ~SpirvBlob();
+
+  size_t byte_size() const { return word_count * sizeof(u32); }
+  void release();
+};
+
+#ifdef RUNTIME_SHADER_COMPILER
+// content addressed cache of compiled shaders.
+// the key covers everything that can change the output of shaderc, so a
+// stale entry can never be hit: the source itself and its path (includes
+// resolve relative to it), the shader kind, the compile options, the
+// shaderc build and the spirv version/revision it emits.
+struct ShaderCache {
+  path directory;
+
+  void init(path directory);
+  u64 key(const string& source_code,
+          const path& source_path,
+          shaderc_shader_kind kind,
+          bool optimize) const;
+  path entry_path(u64 key) const;
+  optional<SpirvBlob> load(u64 key) const;
+  void store(u64 key, const vector<u32>& spirv) const;
+};
+#endif
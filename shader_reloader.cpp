@@ -0,0 +1,123 @@
+#include "shader_reloader.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <map>
+#endif
+
+static bool is_shader_file(const path& p) {
+  static const vector<string> extensions = {".vert", ".frag", ".comp",
+                                            ".geom", ".tesc", ".tese",
+                                            ".glsl"};
+  string extension = p.extension().string();
+  for (auto& e : extensions) {
+    if (extension == e) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ShaderReloader::start(path directory, function<void()>&& on_change) {
+  if (!exists(directory)) {
+    println("not watching {} for shader changes, it doesn't exist",
+            directory.string());
+    return;
+  }
+  this->directory = directory;
+  this->on_change = std::move(on_change);
+  stopping = false;
+  watcher = thread([this]() { this->watch(); });
+}
+
+void ShaderReloader::stop() {
+  stopping = true;
+  if (watcher.joinable()) {
+    watcher.join();
+  }
+}
+
+void ShaderReloader::notify() {
+  try {
+    on_change();
+  } catch (const exception& e) {
+    // keep drawing with the old pipelines until the shader is fixed
+    println("shader reload failed: {}", e.what());
+  }
+}
+
+void ShaderReloader::watch() {
+  // editors tend to save in several steps (truncate, write, rename), so wait
+  // for things to settle before compiling
+  const auto settle_time = chrono::milliseconds(50);
+
+#ifdef __linux__
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0 || inotify_add_watch(fd, directory.c_str(),
+                                  IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    println("unable to watch {} for shader changes", directory.string());
+    if (fd >= 0) {
+      close(fd);
+    }
+    return;
+  }
+
+  // returns true if any of the queued events touched a shader
+  auto drain = [fd]() {
+    alignas(inotify_event) char buffer[4096];
+    bool touched_shader = false;
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+      for (char* p = buffer; p < buffer + length;) {
+        auto* event = reinterpret_cast<inotify_event*>(p);
+        if (event->len > 0 && is_shader_file(event->name)) {
+          touched_shader = true;
+        }
+        p += sizeof(inotify_event) + event->len;
+      }
+    }
+    return touched_shader;
+  };
+
+  while (!stopping) {
+    // time out regularly to notice `stopping`
+    pollfd poll_fd = {.fd = fd, .events = POLLIN};
+    if (poll(&poll_fd, 1, 200) <= 0) {
+      continue;
+    }
+    bool touched_shader = drain();
+    this_thread::sleep_for(settle_time);
+    touched_shader |= drain();
+    if (touched_shader) {
+      notify();
+    }
+  }
+  close(fd);
+#else
+  // no inotify, poll modification times instead
+  auto snapshot = [this]() {
+    map<path, file_time_type> times;
+    error_code ec;
+    for (auto& entry : directory_iterator(directory, ec)) {
+      if (is_shader_file(entry.path())) {
+        times[entry.path()] = entry.last_write_time(ec);
+      }
+    }
+    return times;
+  };
+
+  auto times = snapshot();
+  while (!stopping) {
+    this_thread::sleep_for(chrono::milliseconds(250));
+    auto current = snapshot();
+    if (current != times) {
+      this_thread::sleep_for(settle_time);
+      times = snapshot();
+      notify();
+    }
+  }
+#endif
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "lib.hpp"
+
+// watches shaders/ on a background thread and calls `on_change` whenever a
+// shader is saved. the pipeline registry rebuilds on its workers and swaps
+// the results in at a frame boundary, so nothing ever waits on the device.
+struct ShaderReloader {
+  path directory;
+  thread watcher;
+  atomic<bool> stopping = false;
+  function<void()> on_change;
+
+  void start(path directory, function<void()>&& on_change);
+  void stop();
+
+ private:
+  void watch();
+  void notify();
+};
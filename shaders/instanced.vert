@@ -0,0 +1,38 @@
+#version 460
+#pragma shaderc_vertex_shader
+#extension GL_KHR_vulkan_glsl : enable
+#extension GL_EXT_buffer_reference : require
+#pragma shader_stage(vertex)
+
+// main.vert with the per instance inputs of
+// VertexLayout::position_color_instanced
+
+// DrawData in draw_state.hpp
+struct DrawData {
+  vec4 offset;
+  vec4 tint;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer
+DrawDataBuffer {
+  DrawData draws[];
+};
+
+// DrawConstants in pipeline.hpp
+layout(push_constant) uniform DrawConstants {
+  DrawDataBuffer draw_data;
+  uint first_draw;
+} constants;
+
+layout(location = 0) in vec3 coord;
+layout(location = 1) in vec3 color;
+// InstanceData in lib.hpp, binding 1 at instance rate
+layout(location = 2) in mat4 instance_transform;
+layout(location = 6) in vec4 instance_color;
+layout(location = 0) out vec3 frag_color;
+
+void main() {
+  DrawData draw = constants.draw_data.draws[constants.first_draw + gl_DrawID];
+  gl_Position = instance_transform * vec4(coord.xyz + draw.offset.xyz, 1.);
+  frag_color = color * draw.tint.rgb * instance_color.rgb;
+}
@@ -1,13 +1,33 @@
 #version 460
 #pragma shaderc_vertex_shader
 #extension GL_KHR_vulkan_glsl : enable
+#extension GL_EXT_buffer_reference : require
 #pragma shader_stage(vertex)
 
+// DrawData in draw_state.hpp
+struct DrawData {
+  vec4 offset;
+  vec4 tint;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer
+DrawDataBuffer {
+  DrawData draws[];
+};
+
+// DrawConstants in pipeline.hpp
+layout(push_constant) uniform DrawConstants {
+  DrawDataBuffer draw_data;
+  uint first_draw;
+} constants;
+
 layout(location = 0) in vec3 coord;
 layout(location = 1) in vec3 color;
 layout(location = 0) out vec3 frag_color;
 
 void main() {
-  gl_Position = vec4(coord.xyz, 1.);
-  frag_color = color;
-}
\ No newline at end of file
+  // gl_DrawID counts the draws of one multi-draw indirect call
+  DrawData draw = constants.draw_data.draws[constants.first_draw + gl_DrawID];
+  gl_Position = vec4(coord.xyz + draw.offset.xyz, 1.);
+  frag_color = color * draw.tint.rgb;
+}
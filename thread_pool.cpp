@@ -0,0 +1,50 @@
+#include "thread_pool.hpp"
+
+#include "trace.hpp"
+
+void ThreadPool::init(u32 count, const string& name) {
+  if (count == 0) {
+    u32 cores = thread::hardware_concurrency();
+    count = cores > 1 ? cores - 1 : 1;
+  }
+  stopping = false;
+  workers.reserve(count);
+  for (u32 i = 0; i < count; i++) {
+    workers.emplace_back([this, name, i]() {
+      tracer.name_thread(fmt::format("{} {}", name, i));
+      this->work();
+    });
+  }
+}
+
+void ThreadPool::work() {
+  while (true) {
+    function<void()> task;
+    {
+      unique_lock lock(tasks_mutex);
+      tasks_available.wait(lock,
+                           [this]() { return stopping || !tasks.empty(); });
+      // drain the queue before exiting so no future is left dangling
+      if (tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::shutdown() {
+  {
+    lock_guard lock(tasks_mutex);
+    stopping = true;
+  }
+  tasks_available.notify_all();
+  for (auto& worker : workers) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  workers.clear();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "lib.hpp"
+
+// fixed size pool of worker threads for work that would otherwise serialize
+// on the main thread. tasks run in submission order, so whatever waits on
+// them every frame (recording) gets a pool of its own instead of queueing
+// behind shader compilation and pipeline creation
+struct ThreadPool {
+  vector<thread> workers;
+  deque<function<void()>> tasks;
+  mutex tasks_mutex;
+  condition_variable tasks_available;
+  bool stopping = false;
+
+  // 0 picks one thread per core, leaving one for the main thread. threads
+  // show up in traces as "`name` i"
+  void init(u32 count = 0, const string& name = "worker");
+  void shutdown();
+  u32 size() const { return static_cast<u32>(workers.size()); }
+
+  template <typename F>
+  auto submit(F&& fn) -> future<invoke_result_t<F>> {
+    using R = invoke_result_t<F>;
+    // packaged_task is move only, but the queue stores copyable functions
+    auto task = make_shared<packaged_task<R()>>(std::forward<F>(fn));
+    future<R> result = task->get_future();
+    {
+      lock_guard lock(tasks_mutex);
+      tasks.emplace_back([task]() { (*task)(); });
+    }
+    tasks_available.notify_one();
+    return result;
+  }
+
+ private:
+  void work();
+};
@@ -0,0 +1,67 @@
+#include "timeline.hpp"
+
+#include "host_allocator.hpp"
+
+void Timeline::init(VkDevice device) {
+  this->device = device;
+  VkSemaphoreTypeCreateInfo type_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = 0,
+  };
+  VkSemaphoreCreateInfo semaphore_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      .pNext = &type_info,
+  };
+  VK_CHECK(vkCreateSemaphore(device, &semaphore_info,
+                             vk_allocator(VK_OBJECT_TYPE_SEMAPHORE),
+                             &semaphore),
+           "unable to create timeline semaphore");
+}
+
+void Timeline::destroy() {
+  vkDestroySemaphore(device, semaphore,
+                     vk_allocator(VK_OBJECT_TYPE_SEMAPHORE));
+}
+
+u64 Timeline::next() {
+  return ++last_submitted;
+}
+
+bool Timeline::is_complete(u64 value) {
+  return value <= last_completed || value <= completed();
+}
+
+u64 Timeline::completed() {
+  u64 value;
+  VK_CHECK(vkGetSemaphoreCounterValue(device, semaphore, &value),
+           "unable to query timeline semaphore");
+  last_completed = max(last_completed, value);
+  return last_completed;
+}
+
+void Timeline::wait(u64 value) {
+  if (value <= last_completed) {
+    return;
+  }
+  VkSemaphoreWaitInfo wait_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      .semaphoreCount = 1,
+      .pSemaphores = &semaphore,
+      .pValues = &value,
+  };
+  VK_CHECK(vkWaitSemaphores(device, &wait_info, UINT64_MAX),
+           "failed to wait for timeline semaphore");
+  last_completed = value;
+}
+
+VkSemaphoreSubmitInfo Timeline::signal_info(u64 value) const {
+  return {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+      .semaphore = semaphore,
+      .value = value,
+      // all earlier commands on the queue are in the signal's first scope,
+      // which is what lets one value stand for everything before it
+      .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+  };
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "lib.hpp"
+
+// one timeline semaphore for everything submitted to the queue. every
+// submission (frames and upload batches alike) signals the next value, and
+// since a signal covers all work submitted before it, "has submission N
+// finished" is a single comparison against the semaphore's counter. there
+// is nothing to reset, and any thread may wait on a value.
+struct Timeline {
+  VkDevice device = VK_NULL_HANDLE;
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+  // the value of the most recent submission, 0 before the first one
+  u64 last_submitted = 0;
+  // last counter value seen, so polling a finished value skips the query
+  u64 last_completed = 0;
+
+  void init(VkDevice device);
+  void destroy();
+
+  // the value a submission about to be made signals. values have to be
+  // signaled in the order they are handed out, so only call this right
+  // before submitting, on the submitting thread
+  u64 next();
+  // every submission up to and including `value` has finished
+  bool is_complete(u64 value);
+  u64 completed();
+  void wait(u64 value);
+  // to put in VkSubmitInfo2::pSignalSemaphoreInfos
+  VkSemaphoreSubmitInfo signal_info(u64 value) const;
+};
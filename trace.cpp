@@ -0,0 +1,103 @@
+#include "trace.hpp"
+
+Tracer tracer;
+
+static string json_escape(const string& text) {
+  string escaped;
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\\':
+        escaped += "\\\\";
+        break;
+      case '\n':
+        escaped += "\\n";
+        break;
+      default:
+        escaped += c;
+    }
+  }
+  return escaped;
+}
+
+static double microseconds(chrono::steady_clock::duration duration) {
+  return chrono::duration<double, micro>(duration).count();
+}
+
+void Tracer::start() {
+  epoch = chrono::steady_clock::now();
+  enabled = true;
+  name_thread("main");
+}
+
+void Tracer::name_thread(string name) {
+  if (!enabled.load(memory_order_relaxed)) {
+    return;
+  }
+  current_thread().name = std::move(name);
+}
+
+TraceThread& Tracer::current_thread() {
+  thread_local TraceThread* thread = nullptr;
+  if (thread == nullptr) {
+    lock_guard lock(threads_mutex);
+    threads.push_back(make_unique<TraceThread>());
+    thread = threads.back().get();
+    thread->id = static_cast<u32>(threads.size());
+  }
+  return *thread;
+}
+
+void Tracer::record(const char* name,
+                    string&& detail,
+                    chrono::steady_clock::time_point start,
+                    chrono::steady_clock::time_point end) {
+  TraceThread& thread = current_thread();
+  thread.events.push_back({.name = name,
+                           .detail = std::move(detail),
+                           .start = start - epoch,
+                           .duration = end - start});
+}
+
+void Tracer::write(const path& file) {
+  if (file.has_parent_path()) {
+    create_directories(file.parent_path());
+  }
+  ofstream out(file, ios::trunc);
+  if (!out) {
+    println("unable to write trace to {}", file.string());
+    return;
+  }
+
+  size_t event_count = 0;
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  const char* separator = "\n";
+  lock_guard lock(threads_mutex);
+  for (auto& thread : threads) {
+    if (!thread->name.empty()) {
+      out << fmt::format(
+          "{}{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+          "\"tid\": {}, \"args\": {{\"name\": \"{}\"}}}}",
+          separator, thread->id, json_escape(thread->name));
+      separator = ",\n";
+    }
+    for (auto& event : thread->events) {
+      out << fmt::format(
+          "{}{{\"name\": \"{}\", \"ph\": \"X\", \"ts\": {:.3f}, "
+          "\"dur\": {:.3f}, \"pid\": 1, \"tid\": {}",
+          separator, json_escape(event.name), microseconds(event.start),
+          microseconds(event.duration), thread->id);
+      if (!event.detail.empty()) {
+        out << fmt::format(", \"args\": {{\"detail\": \"{}\"}}",
+                           json_escape(event.detail));
+      }
+      out << "}";
+      separator = ",\n";
+    }
+    event_count += thread->events.size();
+  }
+  out << "\n]}\n";
+  println("wrote {} trace events to {}", event_count, file.string());
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "lib.hpp"
+
+struct TraceEvent {
+  const char* name;
+  string detail;
+  // since the tracer started
+  chrono::steady_clock::duration start;
+  chrono::steady_clock::duration duration;
+};
+
+struct TraceThread {
+  u32 id;
+  string name;
+  // only touched by its own thread until the trace is written
+  vector<TraceEvent> events;
+};
+
+// cpu time spans written as chrome trace event json, which
+// chrome://tracing and ui.perfetto.dev open. every thread records into its
+// own buffer. while disabled a span costs one relaxed atomic load
+struct Tracer {
+  atomic<bool> enabled = false;
+  chrono::steady_clock::time_point epoch;
+  mutex threads_mutex;
+  // kept until exit, so threads that are gone still show up
+  vector<unique_ptr<TraceThread>> threads;
+
+  // names the calling thread "main"
+  void start();
+  void name_thread(string name);
+  void record(const char* name,
+              string&& detail,
+              chrono::steady_clock::time_point start,
+              chrono::steady_clock::time_point end);
+  // every thread that recorded must be done with its spans
+  void write(const path& file);
+
+ private:
+  TraceThread& current_thread();
+};
+
+extern Tracer tracer;
+
+// records from construction until `end` or the end of the scope. `detail`
+// is only formatted while tracing
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name) : name(name) {
+    if (tracer.enabled.load(memory_order_relaxed)) {
+      active = true;
+      start = chrono::steady_clock::now();
+    }
+  }
+  template <typename... T>
+  TraceScope(const char* name, fmt::format_string<T...> detail, T&&... args)
+      : name(name) {
+    if (tracer.enabled.load(memory_order_relaxed)) {
+      active = true;
+      this->detail = fmt::format(detail, std::forward<T>(args)...);
+      start = chrono::steady_clock::now();
+    }
+  }
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+  ~TraceScope() { end(); }
+
+  void end() {
+    if (active) {
+      active = false;
+      tracer.record(name, std::move(detail), start,
+                    chrono::steady_clock::now());
+    }
+  }
+
+ private:
+  const char* name;
+  string detail;
+  chrono::steady_clock::time_point start;
+  bool active = false;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// traces the rest of the enclosing scope
+#define TRACE_SCOPE(...) \
+  TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
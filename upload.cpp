@@ -0,0 +1,364 @@
+#include "upload.hpp"
+
+#include <algorithm>
+
+void UploadManager::init(VkDevice device,
+                         VmaAllocator allocator,
+                         VkQueue queue,
+                         FrameCommandPools* command_pools,
+                         Timeline* timeline,
+                         VkDeviceSize capacity) {
+  this->device = device;
+  this->allocator = allocator;
+  this->queue = queue;
+  this->command_pools = command_pools;
+  this->timeline = timeline;
+  this->capacity = capacity;
+
+  VkBufferCreateInfo buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = capacity,
+      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  };
+  VmaAllocationCreateInfo alloc_info = {
+      // written once front to back, never read back
+      .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+               VMA_ALLOCATION_CREATE_MAPPED_BIT,
+      .usage = VMA_MEMORY_USAGE_AUTO,
+  };
+  VmaAllocationInfo allocation_info;
+  VK_CHECK(vmaCreateBuffer(allocator, &buffer_info, &alloc_info,
+                           &staging_buffer, &staging_allocation,
+                           &allocation_info),
+           "unable to create upload staging buffer");
+  staging_data = static_cast<char*>(allocation_info.pMappedData);
+}
+
+void UploadManager::destroy() {
+  flush();
+  while (!in_flight.empty()) {
+    retire(true);
+  }
+  vmaDestroyBuffer(allocator, staging_buffer, staging_allocation);
+}
+
+optional<VkDeviceSize> UploadManager::try_allocate(VkDeviceSize size,
+                                                   VkDeviceSize alignment) {
+  if (used == capacity) {
+    return nullopt;
+  }
+  if (used == 0) {
+    // nothing in flight, start over so big uploads get the whole ring
+    head = 0;
+  }
+  VkDeviceSize tail = (head + capacity - used) % capacity;
+  VkDeviceSize start = (head + alignment - 1) / alignment * alignment;
+  VkDeviceSize consumed;
+
+  if (head >= tail) {
+    // free space is [head, capacity) followed by [0, tail)
+    if (start + size <= capacity) {
+      consumed = start - head + size;
+    } else if (size <= tail) {
+      // the rest of the ring is wasted until this submission retires
+      consumed = capacity - head + size;
+      start = 0;
+    } else {
+      return nullopt;
+    }
+  } else {
+    // free space is [head, tail)
+    if (start + size > tail) {
+      return nullopt;
+    }
+    consumed = start - head + size;
+  }
+
+  head = (start + size) % capacity;
+  used += consumed;
+  pending_ring_bytes += consumed;
+  return start;
+}
+
+VkDeviceSize UploadManager::allocate(VkDeviceSize size,
+                                     VkDeviceSize alignment) {
+  if (size > capacity) {
+    throw runtime_error(fmt::format(
+        "upload of {} bytes doesn't fit the {} byte staging ring", size,
+        capacity));
+  }
+  while (true) {
+    if (auto offset = try_allocate(size, alignment)) {
+      return offset.value();
+    }
+    // space held by recorded copies is only released once they've run
+    flush();
+    if (in_flight.empty()) {
+      throw runtime_error("upload staging ring is out of space");
+    }
+    retire(true);
+  }
+}
+
+UploadManager::Ticket UploadManager::upload_buffer(VkBuffer buffer,
+                                                   VkDeviceSize offset,
+                                                   const void* data,
+                                                   VkDeviceSize size) {
+  // small enough chunks that the ring can keep copying while the gpu drains
+  // earlier ones
+  const VkDeviceSize chunk_limit = capacity / 4;
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    VkDeviceSize chunk = min(size, chunk_limit);
+    VkDeviceSize staging_offset = allocate(chunk, 16);
+    memcpy(staging_data + staging_offset, bytes, chunk);
+    buffer_copies.push_back({.buffer = buffer,
+                             .region = {.srcOffset = staging_offset,
+                                        .dstOffset = offset,
+                                        .size = chunk}});
+    bytes += chunk;
+    offset += chunk;
+    size -= chunk;
+  }
+  return next_ticket;
+}
+
+UploadManager::Ticket UploadManager::upload_image(
+    VkImage image,
+    VkExtent3D extent,
+    VkImageAspectFlags aspect,
+    const void* data,
+    VkDeviceSize size,
+    VkImageLayout final_layout) {
+  VkDeviceSize staging_offset = allocate(size, 16);
+  memcpy(staging_data + staging_offset, data, size);
+  image_copies.push_back(
+      {.image = image,
+       .region = {.bufferOffset = staging_offset,
+                  // tightly packed
+                  .bufferRowLength = 0,
+                  .bufferImageHeight = 0,
+                  .imageSubresource = {.aspectMask = aspect,
+                                       .mipLevel = 0,
+                                       .baseArrayLayer = 0,
+                                       .layerCount = 1},
+                  .imageOffset = {0, 0, 0},
+                  .imageExtent = extent},
+       .final_layout = final_layout});
+  return next_ticket;
+}
+
+UploadManager::Ticket UploadManager::flush() {
+  if (buffer_copies.empty() && image_copies.empty()) {
+    return next_ticket - 1;
+  }
+  retire(false);
+
+  // reclaimed with the frame's pool, which outlives this batch since the
+  // frame is submitted after it
+  VkCommandBuffer command_buffer =
+      command_pools->allocate(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+  VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+  };
+  VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info),
+           "unable to begin upload command buffer");
+
+  // the copies may overwrite buffers that earlier submissions (frames in
+  // flight) still read or write, so they wait for all prior work first
+  VkMemoryBarrier2 prior_work_done = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .srcAccessMask =
+          VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+      .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+  };
+  vector<VkImageMemoryBarrier2> to_transfer;
+  vector<VkImageMemoryBarrier2> to_final;
+  for (auto& copy : image_copies) {
+    VkImageSubresourceRange range = {
+        .aspectMask = copy.region.imageSubresource.aspectMask,
+        .levelCount = 1,
+        .layerCount = 1,
+    };
+    to_transfer.push_back({
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask = VK_ACCESS_2_NONE,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .image = copy.image,
+        .subresourceRange = range,
+    });
+    to_final.push_back({
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = copy.final_layout,
+        .image = copy.image,
+        .subresourceRange = range,
+    });
+  }
+  VkDependencyInfo before_copies = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = buffer_copies.empty() ? 0u : 1u,
+      .pMemoryBarriers = &prior_work_done,
+      .imageMemoryBarrierCount = static_cast<u32>(to_transfer.size()),
+      .pImageMemoryBarriers = to_transfer.data(),
+  };
+  vkCmdPipelineBarrier2(command_buffer, &before_copies);
+
+  // regions within one vkCmdCopyBuffer are copied in no particular order,
+  // so a region overlapping an earlier write to the same buffer goes into a
+  // later pass, with a barrier in between. without overlaps there is one
+  // pass and one vkCmdCopyBuffer per destination, however many chunks it
+  // received
+  stable_sort(buffer_copies.begin(), buffer_copies.end(),
+              [](const BufferCopy& a, const BufferCopy& b) {
+                return a.buffer < b.buffer;
+              });
+  vector<u32> passes(buffer_copies.size(), 0);
+  u32 pass_count = buffer_copies.empty() ? 0 : 1;
+  for (size_t i = 0, first = 0; i < buffer_copies.size(); i++) {
+    if (buffer_copies[i].buffer != buffer_copies[first].buffer) {
+      first = i;
+    }
+    const VkBufferCopy& region = buffer_copies[i].region;
+    for (size_t j = first; j < i; j++) {
+      const VkBufferCopy& earlier = buffer_copies[j].region;
+      if (region.dstOffset < earlier.dstOffset + earlier.size &&
+          earlier.dstOffset < region.dstOffset + region.size) {
+        passes[i] = max(passes[i], passes[j] + 1);
+      }
+    }
+    pass_count = max(pass_count, passes[i] + 1);
+  }
+  VkMemoryBarrier2 pass_done = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+      .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+  };
+  VkDependencyInfo between_passes = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &pass_done,
+  };
+  vector<VkBufferCopy> regions;
+  for (u32 pass = 0; pass < pass_count; pass++) {
+    if (pass > 0) {
+      vkCmdPipelineBarrier2(command_buffer, &between_passes);
+    }
+    for (size_t i = 0; i < buffer_copies.size();) {
+      VkBuffer buffer = buffer_copies[i].buffer;
+      regions.clear();
+      for (; i < buffer_copies.size() && buffer_copies[i].buffer == buffer;
+           i++) {
+        if (passes[i] == pass) {
+          regions.push_back(buffer_copies[i].region);
+        }
+      }
+      if (!regions.empty()) {
+        vkCmdCopyBuffer(command_buffer, staging_buffer, buffer,
+                        static_cast<u32>(regions.size()), regions.data());
+      }
+    }
+  }
+
+  for (auto& copy : image_copies) {
+    vkCmdCopyBufferToImage(command_buffer, staging_buffer, copy.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                           &copy.region);
+  }
+
+  // later submissions on the queue (the frames) see the copied data without
+  // waiting on the timeline themselves
+  VkMemoryBarrier2 copies_visible = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+      .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
+  };
+  VkDependencyInfo dependency_info = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &copies_visible,
+      .imageMemoryBarrierCount = static_cast<u32>(to_final.size()),
+      .pImageMemoryBarriers = to_final.data(),
+  };
+  vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+
+  VK_CHECK(vkEndCommandBuffer(command_buffer),
+           "unable to end upload command buffer");
+
+  // no-op on host coherent memory
+  VK_CHECK(vmaFlushAllocation(allocator, staging_allocation, 0, VK_WHOLE_SIZE),
+           "unable to flush upload staging buffer");
+
+  VkCommandBufferSubmitInfo command_buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+      .commandBuffer = command_buffer,
+  };
+  u64 timeline_value = timeline->next();
+  VkSemaphoreSubmitInfo signal_info = timeline->signal_info(timeline_value);
+  VkSubmitInfo2 submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+      .commandBufferInfoCount = 1,
+      .pCommandBufferInfos = &command_buffer_info,
+      .signalSemaphoreInfoCount = 1,
+      .pSignalSemaphoreInfos = &signal_info,
+  };
+  VK_CHECK(vkQueueSubmit2(queue, 1, &submit_info, VK_NULL_HANDLE),
+           "unable to submit uploads");
+  command_pools->submitted(timeline_value);
+
+  Ticket ticket = next_ticket++;
+  in_flight.push_back({.ticket = ticket,
+                       .timeline_value = timeline_value,
+                       .ring_bytes = pending_ring_bytes});
+  pending_ring_bytes = 0;
+  buffer_copies.clear();
+  image_copies.clear();
+  return ticket;
+}
+
+void UploadManager::retire(bool block) {
+  while (!in_flight.empty()) {
+    Submission& submission = in_flight.front();
+    if (block) {
+      timeline->wait(submission.timeline_value);
+    } else if (!timeline->is_complete(submission.timeline_value)) {
+      return;
+    }
+
+    used -= submission.ring_bytes;
+    completed_ticket = submission.ticket;
+    in_flight.pop_front();
+    // only the oldest one is worth blocking on
+    block = false;
+  }
+}
+
+bool UploadManager::is_complete(Ticket ticket) {
+  retire(false);
+  return completed_ticket >= ticket;
+}
+
+void UploadManager::wait(Ticket ticket) {
+  if (ticket >= next_ticket) {
+    flush();
+  }
+  while (completed_ticket < ticket && !in_flight.empty()) {
+    retire(true);
+  }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "command_pools.hpp"
+#include "lib.hpp"
+#include "timeline.hpp"
+
+// moves data into device-local buffers and images through a persistently
+// mapped staging ring. copies are batched and only submitted on `flush` (or
+// when the ring runs out of space), and ring space is reclaimed as the
+// submissions that read from it complete. every upload returns a ticket
+// that can be polled or waited on. batches signal the queue's timeline, so
+// completion is tracked without fences of their own, and their command
+// buffers come from the current frame's pool. a batch waits for all work
+// submitted before it, so destinations may still be in use by frames in
+// flight, and writes to overlapping ranges land in the order they were made.
+struct UploadManager {
+  using Ticket = u64;
+
+  struct BufferCopy {
+    VkBuffer buffer;
+    VkBufferCopy region;
+  };
+
+  struct ImageCopy {
+    VkImage image;
+    VkBufferImageCopy region;
+    VkImageLayout final_layout;
+  };
+
+  struct Submission {
+    Ticket ticket;
+    // what the batch signals on the timeline
+    u64 timeline_value;
+    // ring bytes (including alignment and wrap-around waste) it releases
+    VkDeviceSize ring_bytes;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  VmaAllocator allocator = VK_NULL_HANDLE;
+  VkQueue queue = VK_NULL_HANDLE;
+  FrameCommandPools* command_pools = nullptr;
+  Timeline* timeline = nullptr;
+
+  VkBuffer staging_buffer = VK_NULL_HANDLE;
+  VmaAllocation staging_allocation = VK_NULL_HANDLE;
+  char* staging_data = nullptr;
+  VkDeviceSize capacity = 0;
+  // next byte to hand out, and how many bytes the gpu may still be reading.
+  // the oldest byte in use is `used` bytes behind `head`
+  VkDeviceSize head = 0;
+  VkDeviceSize used = 0;
+  VkDeviceSize pending_ring_bytes = 0;
+
+  vector<BufferCopy> buffer_copies;
+  vector<ImageCopy> image_copies;
+  deque<Submission> in_flight;
+  // the ticket the copies recorded right now will be submitted under
+  Ticket next_ticket = 1;
+  Ticket completed_ticket = 0;
+
+  void init(VkDevice device,
+            VmaAllocator allocator,
+            VkQueue queue,
+            FrameCommandPools* command_pools,
+            Timeline* timeline,
+            VkDeviceSize capacity = 64 << 20);
+  void destroy();
+
+  // large uploads are split into chunks, flushing as the ring fills up
+  Ticket upload_buffer(VkBuffer buffer,
+                       VkDeviceSize offset,
+                       const void* data,
+                       VkDeviceSize size);
+  // the whole image has to fit in the ring. the image ends up in
+  // `final_layout`
+  Ticket upload_image(VkImage image,
+                      VkExtent3D extent,
+                      VkImageAspectFlags aspect,
+                      const void* data,
+                      VkDeviceSize size,
+                      VkImageLayout final_layout);
+  // submits everything recorded so far as one batch. returns its ticket
+  Ticket flush();
+  bool is_complete(Ticket ticket);
+  void wait(Ticket ticket);
+
+ private:
+  optional<VkDeviceSize> try_allocate(VkDeviceSize size,
+                                      VkDeviceSize alignment);
+  // flushes and retires submissions until `size` bytes fit
+  VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment);
+  // releases completed submissions, blocking on the oldest one if `block`
+  void retire(bool block);
+};